@@ -0,0 +1,567 @@
+#include "Benchmarks.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "Bvh.hpp"
+#include "FrameProfiler.hpp"
+#include "FrustumCulling.hpp"
+#include "JobSystem.hpp"
+#include "MemoryAllocator.hpp"
+#include "Scene.hpp"
+#include "Timeline.hpp"
+#include "TransformHierarchy.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double elapsedNanoseconds(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+void printLatencies(std::ostream& out, const char* label, const std::vector<double>& samples)
+{
+    auto summary = summarize(samples);
+    double totalNanoseconds = std::accumulate(samples.begin(), samples.end(), 0.0);
+    out << std::left << std::setw(22) << label << std::right << std::fixed << std::setprecision(1)
+        << std::setw(12) << static_cast<double>(samples.size()) / (totalNanoseconds * 1e-9) << " ops/s"
+        << "  p50 " << summary.p50 << "ns  p99 " << summary.p99 << "ns  max " << summary.max << "ns\n"
+        << std::defaultfloat;
+}
+
+// Sizes are log-uniform between 256 B and 4 MiB, which is roughly the spread
+// between a small constant block and a large mesh.
+VkMemoryRequirements randomRequirements(std::mt19937& rng, uint32_t memoryTypeIndex)
+{
+    std::uniform_real_distribution<double> logSize(8.0, 22.0);
+    std::uniform_int_distribution<int> alignmentShift(4, 12);
+    VkMemoryRequirements requirements {};
+    requirements.size = static_cast<VkDeviceSize>(std::exp2(logSize(rng)));
+    requirements.alignment = VkDeviceSize(1) << alignmentShift(rng);
+    requirements.memoryTypeBits = 1u << memoryTypeIndex;
+    return requirements;
+}
+
+// Mirrors the layout of the per-object uniform block.
+struct ObjectConstants {
+    glm::mat4 model;
+    glm::mat4 view;
+    glm::mat4 proj;
+};
+
+const uint32_t JOB_BENCH_WARMUP_FRAMES = 20;
+const uint32_t JOB_BENCH_FRAMES = 200;
+
+const uint32_t TRANSFORM_BENCH_WARMUP_FRAMES = 10;
+const uint32_t TRANSFORM_BENCH_FRAMES = 100;
+const uint32_t TRANSFORM_BENCH_ROOTS = 64;
+
+const uint32_t CULL_BENCH_WARMUP_PASSES = 5;
+const uint32_t CULL_BENCH_PASSES = 100;
+
+const uint32_t BVH_BENCH_QUERIES = 1000;
+const uint32_t BVH_BENCH_RAYS_PER_QUERY = 64;
+const uint32_t BVH_BENCH_FRAMES = 200;
+
+const uint32_t SYNC_BENCH_IN_FLIGHT = 2;
+const uint32_t SYNC_BENCH_PENDING = 8;
+
+void submitEmpty(VkQueue queue, VkFence fence, VkSemaphore timeline = VK_NULL_HANDLE, uint64_t value = 0)
+{
+    SubmitSemaphores semaphores;
+    if (timeline != VK_NULL_HANDLE)
+        semaphores.signal(timeline, value);
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    VkTimelineSemaphoreSubmitInfo timelineInfo {};
+    semaphores.apply(submitInfo, timelineInfo);
+    if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit benchmark batch!");
+    }
+}
+}
+
+void runAllocatorBenchmark(MemoryAllocator& allocator, VkDevice device, uint32_t memoryTypeIndex, uint64_t iterations, std::ostream& out)
+{
+    const size_t maxLive = 4096;
+    std::mt19937 rng(1234);
+    std::vector<Allocation> live;
+    live.reserve(maxLive);
+    std::vector<double> allocateSamples, freeSamples;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        bool allocate = live.empty() || (live.size() < maxLive && rng() % 100 < 55);
+        if (allocate) {
+            auto kind = rng() % 4 == 0 ? AllocationKind::Optimal : AllocationKind::Linear;
+            auto requirements = randomRequirements(rng, memoryTypeIndex);
+            auto opStart = Clock::now();
+            live.push_back(allocator.allocate(requirements, memoryTypeIndex, kind));
+            allocateSamples.push_back(elapsedNanoseconds(opStart));
+        } else {
+            size_t index = rng() % live.size();
+            std::swap(live[index], live.back());
+            auto opStart = Clock::now();
+            allocator.free(live.back());
+            freeSamples.push_back(elapsedNanoseconds(opStart));
+            live.pop_back();
+        }
+    }
+    auto stats = allocator.stats();
+    for (auto& allocation : live)
+        allocator.free(allocation);
+
+    out << "allocator churn: " << iterations << " ops, " << stats.liveAllocations << " live allocations in "
+        << stats.deviceAllocations << " device allocations, "
+        << stats.usedBytes / (1024 * 1024) << " MiB used of " << stats.reservedBytes / (1024 * 1024) << " MiB reserved\n";
+    printLatencies(out, "  sub-allocate", allocateSamples);
+    printLatencies(out, "  sub-free", freeSamples);
+
+    // Driver baseline: far fewer live objects so it stays well under
+    // maxMemoryAllocationCount.
+    const size_t maxDriverLive = 256;
+    uint64_t driverIterations = std::min<uint64_t>(iterations, 20000);
+    std::vector<VkDeviceMemory> driverLive;
+    std::vector<double> driverAllocateSamples, driverFreeSamples;
+    for (uint64_t i = 0; i < driverIterations; i++) {
+        bool allocate = driverLive.empty() || (driverLive.size() < maxDriverLive && rng() % 100 < 55);
+        if (allocate) {
+            VkMemoryAllocateInfo allocInfo {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = randomRequirements(rng, memoryTypeIndex).size;
+            allocInfo.memoryTypeIndex = memoryTypeIndex;
+            VkDeviceMemory memory;
+            auto opStart = Clock::now();
+            if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+                break;
+            driverAllocateSamples.push_back(elapsedNanoseconds(opStart));
+            driverLive.push_back(memory);
+        } else {
+            size_t index = rng() % driverLive.size();
+            std::swap(driverLive[index], driverLive.back());
+            auto opStart = Clock::now();
+            vkFreeMemory(device, driverLive.back(), nullptr);
+            driverFreeSamples.push_back(elapsedNanoseconds(opStart));
+            driverLive.pop_back();
+        }
+    }
+    for (auto memory : driverLive)
+        vkFreeMemory(device, memory, nullptr);
+
+    out << "driver baseline: " << driverIterations << " ops\n";
+    printLatencies(out, "  vkAllocateMemory", driverAllocateSamples);
+    printLatencies(out, "  vkFreeMemory", driverFreeSamples);
+}
+
+void runJobSystemBenchmark(uint32_t objectCount, std::ostream& out)
+{
+    auto objects = createGridScene(objectCount);
+    std::vector<ObjectConstants> constants(objectCount);
+    std::vector<uint8_t> visible(objectCount);
+    // Same camera as the renderer at its default extent.
+    glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 10.0f);
+    proj[1][1] *= -1;
+    Frustum frustum = extractFrustum(proj * view);
+
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    out << "job system: " << objectCount << " objects, " << JOB_BENCH_FRAMES << " frames per thread count\n";
+    out << std::setw(8) << "threads" << std::setw(12) << "mean ms" << std::setw(12) << "p99 ms"
+        << std::setw(10) << "speedup" << std::setw(12) << "efficiency" << std::setw(10) << "parallel" << '\n';
+
+    double singleThreadMean = 0.0;
+    for (uint32_t threads = 1; threads <= maxThreads; threads++) {
+        JobSystem jobs(threads - 1);
+        std::vector<double> samples;
+        samples.reserve(JOB_BENCH_FRAMES);
+        for (uint32_t frame = 0; frame < JOB_BENCH_WARMUP_FRAMES + JOB_BENCH_FRAMES; frame++) {
+            float time = static_cast<float>(frame) / 60.0f;
+            auto start = Clock::now();
+            jobs.parallelFor(objectCount, jobs.grainSize(objectCount), [&](uint32_t first, uint32_t end) {
+                for (uint32_t i = first; i < end; i++) {
+                    visible[i] = sphereInFrustum(frustum, objects[i].position, QUAD_BOUNDING_RADIUS * objects[i].scale);
+                    constants[i] = { objectTransform(objects[i], time), view, proj };
+                }
+            });
+            if (frame >= JOB_BENCH_WARMUP_FRAMES)
+                samples.push_back(elapsedNanoseconds(start) * 1e-6);
+        }
+
+        auto summary = summarize(samples);
+        if (threads == 1)
+            singleThreadMean = summary.mean;
+        double speedup = singleThreadMean / summary.mean;
+        // Amdahl: speedup = 1 / ((1 - p) + p / n), solved for p.
+        double parallelFraction = threads > 1 ? (1.0 - 1.0 / speedup) / (1.0 - 1.0 / threads) : 1.0;
+        out << std::fixed << std::setprecision(3) << std::setw(8) << threads << std::setw(12) << summary.mean
+            << std::setw(12) << summary.p99 << std::setprecision(2) << std::setw(10) << speedup
+            << std::setw(11) << 100.0 * speedup / threads << '%' << std::setw(10) << parallelFraction
+            << '\n' << std::defaultfloat;
+    }
+
+    // Scheduling overhead: empty children of one root, spawned from the main
+    // thread and drained by every thread.
+    JobSystem jobs(maxThreads - 1);
+    const uint32_t emptyJobs = JobSystem::MAX_JOBS_PER_THREAD - 1;
+    std::vector<double> samples;
+    for (uint32_t round = 0; round < JOB_BENCH_FRAMES; round++) {
+        auto start = Clock::now();
+        Job* root = jobs.create(nullptr);
+        for (uint32_t i = 0; i < emptyJobs; i++)
+            jobs.run(jobs.create(nullptr, root));
+        jobs.run(root);
+        jobs.wait(root);
+        samples.push_back(elapsedNanoseconds(start) / emptyJobs);
+    }
+    out << "empty job on " << maxThreads << " threads: " << std::fixed << std::setprecision(1)
+        << summarize(samples).p50 << " ns (p50)\n" << std::defaultfloat;
+}
+
+void runSyncBenchmark(VkDevice device, VkQueue queue, uint64_t iterations, std::ostream& out)
+{
+    std::vector<VkFence> fences(SYNC_BENCH_PENDING);
+    VkFenceCreateInfo fenceInfo {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    for (auto& fence : fences) {
+        if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create benchmark fence!");
+        }
+    }
+    Timeline timeline;
+    timeline.init(device);
+
+    out << "queue synchronization: " << iterations << " empty submissions per test\n";
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (uint64_t i = 0; i < iterations; i++) {
+        auto opStart = Clock::now();
+        submitEmpty(queue, fences[0]);
+        vkWaitForFences(device, 1, &fences[0], VK_TRUE, UINT64_MAX);
+        vkResetFences(device, 1, &fences[0]);
+        samples.push_back(elapsedNanoseconds(opStart));
+    }
+    printLatencies(out, "  fence round trip", samples);
+    samples.clear();
+    for (uint64_t i = 0; i < iterations; i++) {
+        auto opStart = Clock::now();
+        uint64_t value = timeline.advance();
+        submitEmpty(queue, VK_NULL_HANDLE, timeline.semaphore(), value);
+        timeline.wait(value);
+        samples.push_back(elapsedNanoseconds(opStart));
+    }
+    printLatencies(out, "  timeline round trip", samples);
+
+    // The frame loop: wait for the submission SYNC_BENCH_IN_FLIGHT back, then
+    // submit the next one.
+    samples.clear();
+    for (uint64_t i = 0; i < iterations; i++) {
+        VkFence& fence = fences[i % SYNC_BENCH_IN_FLIGHT];
+        auto opStart = Clock::now();
+        if (i >= SYNC_BENCH_IN_FLIGHT) {
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+        }
+        submitEmpty(queue, fence);
+        samples.push_back(elapsedNanoseconds(opStart));
+    }
+    vkWaitForFences(device, SYNC_BENCH_IN_FLIGHT, fences.data(), VK_TRUE, UINT64_MAX);
+    vkResetFences(device, SYNC_BENCH_IN_FLIGHT, fences.data());
+    printLatencies(out, "  fence frame loop", samples);
+    samples.clear();
+    for (uint64_t i = 0; i < iterations; i++) {
+        auto opStart = Clock::now();
+        if (timeline.submitted() >= SYNC_BENCH_IN_FLIGHT)
+            timeline.wait(timeline.submitted() + 1 - SYNC_BENCH_IN_FLIGHT);
+        submitEmpty(queue, VK_NULL_HANDLE, timeline.semaphore(), timeline.advance());
+        samples.push_back(elapsedNanoseconds(opStart));
+    }
+    timeline.wait(timeline.submitted());
+    printLatencies(out, "  timeline frame loop", samples);
+
+    // How far the queue has got with SYNC_BENCH_PENDING submissions tracked:
+    // a status call per fence against one counter read.
+    samples.clear();
+    for (uint64_t i = 0; i < SYNC_BENCH_PENDING; i++)
+        submitEmpty(queue, fences[i]);
+    for (uint64_t i = 0; i < iterations; i++) {
+        auto opStart = Clock::now();
+        for (auto fence : fences) {
+            if (vkGetFenceStatus(device, fence) != VK_SUCCESS)
+                break;
+        }
+        samples.push_back(elapsedNanoseconds(opStart));
+    }
+    vkWaitForFences(device, SYNC_BENCH_PENDING, fences.data(), VK_TRUE, UINT64_MAX);
+    vkResetFences(device, SYNC_BENCH_PENDING, fences.data());
+    printLatencies(out, "  fence progress", samples);
+    samples.clear();
+    for (uint64_t i = 0; i < SYNC_BENCH_PENDING; i++)
+        submitEmpty(queue, VK_NULL_HANDLE, timeline.semaphore(), timeline.advance());
+    for (uint64_t i = 0; i < iterations; i++) {
+        auto opStart = Clock::now();
+        timeline.completed();
+        samples.push_back(elapsedNanoseconds(opStart));
+    }
+    timeline.wait(timeline.submitted());
+    printLatencies(out, "  timeline progress", samples);
+
+    timeline.destroy();
+    for (auto fence : fences)
+        vkDestroyFence(device, fence, nullptr);
+}
+
+void runCullBenchmark(uint32_t objectCount, std::ostream& out)
+{
+    // Spread well beyond the view volume, so a fair share is culled.
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> coordinate(-6.0f, 6.0f);
+    std::uniform_real_distribution<float> radius(0.01f, 0.2f);
+    BoundingSpheres spheres;
+    spheres.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++)
+        spheres.set(i, glm::vec3(coordinate(rng), coordinate(rng), coordinate(rng)), radius(rng));
+    glm::mat4 view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 10.0f);
+    proj[1][1] *= -1;
+    Frustum frustum = extractFrustum(proj * view);
+
+    out << "culling: " << objectCount << " spheres, " << CULL_BENCH_PASSES << " passes per kernel\n";
+    out << std::left << std::setw(10) << "  kernel" << std::right << std::setw(10) << "visible" << std::setw(12) << "mean ms"
+        << std::setw(12) << "p99 ms" << std::setw(14) << "objects/ns" << std::setw(12) << "mismatch" << '\n';
+    std::vector<uint32_t> reference;
+    std::vector<uint32_t> visible(objectCount);
+    SimdLevel best = detectSimdLevel();
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx2 }) {
+        if (level > best)
+            break;
+        std::vector<double> samples;
+        uint32_t count = 0;
+        for (uint32_t pass = 0; pass < CULL_BENCH_WARMUP_PASSES + CULL_BENCH_PASSES; pass++) {
+            auto start = Clock::now();
+            count = cullSpheres(frustum, spheres, 0, objectCount, visible.data(), level);
+            if (pass >= CULL_BENCH_WARMUP_PASSES)
+                samples.push_back(elapsedNanoseconds(start));
+        }
+        // Fused multiply-adds round differently, which can flip a sphere
+        // that exactly touches a plane; anything more is a bug.
+        if (level == SimdLevel::Scalar)
+            reference.assign(visible.begin(), visible.begin() + count);
+        std::vector<uint32_t> difference;
+        std::set_symmetric_difference(reference.begin(), reference.end(), visible.begin(), visible.begin() + count, std::back_inserter(difference));
+
+        auto summary = summarize(samples);
+        out << "  " << std::left << std::setw(8) << simdLevelName(level) << std::right << std::setw(10) << count << std::fixed
+            << std::setprecision(3) << std::setw(12) << summary.mean * 1e-6 << std::setw(12) << summary.p99 * 1e-6
+            << std::setw(14) << objectCount / summary.mean << std::setw(12) << difference.size() << '\n'
+            << std::defaultfloat;
+    }
+}
+
+void runBvhBenchmark(uint32_t objectCount, std::ostream& out)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> coordinate(-6.0f, 6.0f);
+    std::uniform_real_distribution<float> radius(0.01f, 0.2f);
+    std::uniform_real_distribution<float> velocity(-0.01f, 0.01f);
+    BoundingSpheres spheres;
+    spheres.resize(objectCount);
+    std::vector<Aabb> bounds(objectCount);
+    std::vector<glm::vec3> velocities(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        glm::vec3 center(coordinate(rng), coordinate(rng), coordinate(rng));
+        float r = radius(rng);
+        spheres.set(i, center, r);
+        bounds[i] = { center - glm::vec3(r), center + glm::vec3(r) };
+        velocities[i] = glm::vec3(velocity(rng), velocity(rng), velocity(rng));
+    }
+    glm::vec3 eye(2.0f, 2.0f, 2.0f);
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 10.0f);
+    proj[1][1] *= -1;
+    Frustum frustum = extractFrustum(proj * view);
+
+    Bvh bvh;
+    auto buildStart = Clock::now();
+    bvh.build(bounds);
+    out << "bvh: " << objectCount << " boxes, built in " << std::fixed << std::setprecision(3) << elapsedNanoseconds(buildStart) * 1e-6
+        << " ms, " << bvh.nodeCount() << " nodes, SAH cost " << bvh.cost() << '\n'
+        << std::defaultfloat;
+    out << std::left << std::setw(26) << "  query" << std::right << std::setw(10) << "results" << std::setw(12) << "mean ms"
+        << std::setw(12) << "p99 ms" << std::setw(10) << "missed" << '\n';
+
+    // `missed` counts spheres the linear kernel keeps that a query lost; a
+    // box query keeps a few extra, as a box is looser than its sphere.
+    SimdLevel best = detectSimdLevel();
+    std::vector<uint32_t> reference(objectCount);
+    std::vector<uint32_t> results;
+    auto measure = [&](uint32_t passes, auto&& query) {
+        std::vector<double> samples;
+        uint32_t count = 0;
+        for (uint32_t pass = 0; pass < CULL_BENCH_WARMUP_PASSES + passes; pass++) {
+            auto start = Clock::now();
+            count = query();
+            if (pass >= CULL_BENCH_WARMUP_PASSES)
+                samples.push_back(elapsedNanoseconds(start) * 1e-6);
+        }
+        return std::make_pair(count, summarize(samples));
+    };
+    auto print = [&](const std::string& label, uint32_t count, const TimingSummary& summary, const std::string& missed) {
+        out << std::left << std::setw(26) << label << std::right << std::setw(10) << count << std::fixed << std::setprecision(3)
+            << std::setw(12) << summary.mean << std::setw(12) << summary.p99 << std::setw(10) << missed << '\n'
+            << std::defaultfloat;
+    };
+    auto linearCull = [&] { return cullSpheres(frustum, spheres, 0, objectCount, reference.data(), best); };
+    auto frustumQuery = [&] {
+        results.clear();
+        bvh.queryFrustum(frustum, results);
+        return static_cast<uint32_t>(results.size());
+    };
+    auto missed = [&](uint32_t referenceCount) {
+        std::sort(results.begin(), results.end());
+        std::vector<uint32_t> difference;
+        std::set_difference(reference.begin(), reference.begin() + referenceCount, results.begin(), results.end(), std::back_inserter(difference));
+        return std::to_string(difference.size());
+    };
+
+    auto [linearCount, linear] = measure(CULL_BENCH_PASSES, linearCull);
+    print(std::string("  linear cull (") + simdLevelName(best) + ")", linearCount, linear, "-");
+    auto [frustumCount, frustumTime] = measure(CULL_BENCH_PASSES, frustumQuery);
+    print("  frustum", frustumCount, frustumTime, missed(linearCount));
+
+    // A box half a unit wide, or a bundle of rays from the eye, at fresh
+    // random places each pass; results are from the last pass.
+    std::uniform_real_distribution<float> target(-3.0f, 3.0f);
+    auto [boxCount, boxTime] = measure(BVH_BENCH_QUERIES, [&] {
+        glm::vec3 corner(target(rng), target(rng), target(rng));
+        results.clear();
+        bvh.queryBox({ corner, corner + glm::vec3(0.5f) }, results);
+        return static_cast<uint32_t>(results.size());
+    });
+    print("  box", boxCount, boxTime, "-");
+    auto [rayHits, rayTime] = measure(BVH_BENCH_QUERIES, [&] {
+        uint32_t hits = 0;
+        for (uint32_t r = 0; r < BVH_BENCH_RAYS_PER_QUERY; r++) {
+            RayHit hit {};
+            glm::vec3 direction = glm::vec3(target(rng), target(rng), target(rng)) - eye;
+            hits += bvh.raycast(eye, direction, FLT_MAX, hit) ? 1 : 0;
+        }
+        return hits;
+    });
+    print("  " + std::to_string(BVH_BENCH_RAYS_PER_QUERY) + " rays, closest hits", rayHits, rayTime, "-");
+
+    // Every box drifts each frame, bouncing off the edges of the volume.
+    std::vector<double> updateSamples;
+    for (uint32_t frame = 0; frame < BVH_BENCH_FRAMES; frame++) {
+        for (uint32_t i = 0; i < objectCount; i++) {
+            glm::vec3 center = (bounds[i].min + bounds[i].max) * 0.5f;
+            for (int axis = 0; axis < 3; axis++) {
+                if (std::abs(center[axis] + velocities[i][axis]) > 6.0f)
+                    velocities[i][axis] = -velocities[i][axis];
+            }
+            bounds[i].min += velocities[i];
+            bounds[i].max += velocities[i];
+            spheres.set(i, center + velocities[i], spheres.radius[i]);
+        }
+        auto start = Clock::now();
+        bvh.update(bounds);
+        updateSamples.push_back(elapsedNanoseconds(start) * 1e-6);
+    }
+    auto update = summarize(updateSamples);
+    out << "moving: " << BVH_BENCH_FRAMES << " frames, update mean " << std::fixed << std::setprecision(3) << update.mean << " ms, p99 "
+        << update.p99 << " ms, " << bvh.partialRebuilds() << " partial and " << bvh.fullRebuilds() << " full rebuilds, SAH cost "
+        << bvh.cost() << '\n'
+        << std::defaultfloat;
+    std::tie(linearCount, linear) = measure(CULL_BENCH_PASSES, linearCull);
+    print("  linear cull", linearCount, linear, "-");
+    std::tie(frustumCount, frustumTime) = measure(CULL_BENCH_PASSES, frustumQuery);
+    print("  frustum, updated tree", frustumCount, frustumTime, missed(linearCount));
+}
+
+void runTransformBenchmark(uint32_t nodeCount, glm::mat4* output, JobSystem& jobs, std::ostream& out)
+{
+    // A random recursive tree under a few roots, added in an order that is
+    // not breadth-first; a few dozen levels deep at 100k nodes.
+    std::mt19937 rng(1234);
+    TransformHierarchy hierarchy;
+    std::vector<glm::vec3> offsets(nodeCount);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        uint32_t parent = i < TRANSFORM_BENCH_ROOTS ? TransformHierarchy::NO_PARENT : rng() % i;
+        std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+        offsets[i] = glm::vec3(offset(rng), offset(rng), offset(rng));
+        hierarchy.add(parent, glm::translate(glm::mat4(1.0f), offsets[i]));
+    }
+    auto reorderStart = Clock::now();
+    hierarchy.reorder();
+    out << "transforms: " << nodeCount << " nodes in " << hierarchy.levelCount() << " levels, reordered in " << std::fixed
+        << std::setprecision(3) << elapsedNanoseconds(reorderStart) * 1e-6 << " ms\n"
+        << std::defaultfloat;
+    out << std::left << std::setw(24) << "  kernel" << std::right << std::setw(10) << "updated" << std::setw(12) << "mean ms"
+        << std::setw(12) << "p99 ms" << std::setw(12) << "ns/node" << '\n';
+
+    auto animate = [&](uint32_t frame, uint32_t stride) {
+        float angle = static_cast<float>(frame) * 0.01f;
+        for (uint32_t i = 0; i < nodeCount; i += stride)
+            hierarchy.setLocal(i, glm::rotate(glm::translate(glm::mat4(1.0f), offsets[i]), angle, glm::vec3(0.0f, 0.0f, 1.0f)));
+    };
+    auto measure = [&](const char* label, JobSystem* runOn, uint32_t stride) {
+        std::vector<double> samples;
+        uint32_t updated = 0;
+        for (uint32_t frame = 0; frame < TRANSFORM_BENCH_WARMUP_FRAMES + TRANSFORM_BENCH_FRAMES; frame++) {
+            animate(frame, stride);
+            auto start = Clock::now();
+            updated = hierarchy.update(output, runOn);
+            if (frame >= TRANSFORM_BENCH_WARMUP_FRAMES)
+                samples.push_back(elapsedNanoseconds(start) * 1e-6);
+        }
+        auto summary = summarize(samples);
+        out << std::left << std::setw(24) << label << std::right << std::fixed << std::setprecision(3) << std::setw(10) << updated
+            << std::setw(12) << summary.mean << std::setw(12) << summary.p99 << std::setprecision(2) << std::setw(12)
+            << summary.mean * 1e6 / std::max(updated, 1u) << '\n'
+            << std::defaultfloat;
+    };
+
+    SimdLevel best = detectSimdLevel();
+    std::vector<glm::mat4> reference(nodeCount);
+    for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx, SimdLevel::Avx2 }) {
+        if (level > best)
+            break;
+        hierarchy.setSimdLevel(level);
+        std::string label = std::string("  ") + simdLevelName(level);
+        measure(label.c_str(), nullptr, 1);
+        // Every kernel animates the same frames, so the results must agree.
+        if (level == SimdLevel::Scalar) {
+            std::copy(output, output + nodeCount, reference.begin());
+            continue;
+        }
+        float maxError = 0.0f;
+        for (uint32_t i = 0; i < nodeCount; i++) {
+            for (int c = 0; c < 4; c++) {
+                for (int r = 0; r < 4; r++)
+                    maxError = std::max(maxError, std::abs(output[i][c][r] - reference[i][c][r]));
+            }
+        }
+        if (maxError > 1e-3f) {
+            throw std::runtime_error("SIMD transform results differ from scalar!");
+        }
+    }
+    hierarchy.setSimdLevel(best);
+    std::string label = std::string("  ") + simdLevelName(best) + ", " + std::to_string(jobs.threadCount()) + " threads";
+    measure(label.c_str(), &jobs, 1);
+    // Animating every 1000th node leaves most subtrees clean.
+    label = std::string("  ") + simdLevelName(best) + ", 0.1% animated";
+    measure(label.c_str(), &jobs, 1000);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#include <glm/mat4x4.hpp>
+#include <vulkan/vulkan_core.h>
+
+class JobSystem;
+class MemoryAllocator;
+
+// Randomized allocate/free churn against the sub-allocator, followed by the
+// same pattern (with a smaller live set) against raw vkAllocateMemory.
+void runAllocatorBenchmark(MemoryAllocator& allocator, VkDevice device, uint32_t memoryTypeIndex, uint64_t iterations, std::ostream& out);
+
+// Runs the per-frame CPU work (transforms, culling, constant writes) for
+// objectCount objects as jobs on 1..N threads and reports the frame time,
+// speedup and the parallel fraction implied by Amdahl's law, plus the raw
+// cost of spawning and running an empty job.
+void runJobSystemBenchmark(uint32_t objectCount, std::ostream& out);
+
+// Empty submissions on `queue`, synchronized once with a fence per
+// submission and once with a single timeline semaphore: a submit and wait
+// round trip, a loop keeping two submissions in flight like the frame loop,
+// and the cost of finding out how far the queue has got with eight
+// submissions pending.
+void runSyncBenchmark(VkDevice device, VkQueue queue, uint64_t iterations, std::ostream& out);
+
+// Runs the CPU culling kernel at each SIMD level the CPU has over
+// objectCount spheres scattered around the renderer's camera, on one thread,
+// and reports objects tested per nanosecond.
+void runCullBenchmark(uint32_t objectCount, std::ostream& out);
+
+// Builds a BVH over the boxes of objectCount spheres scattered like the
+// culling benchmark's and times frustum queries against the linear SIMD
+// kernel, plus box and closest-hit ray queries. Then moves every box each
+// frame and times the refit and upkeep, and the frustum query on the
+// degraded tree.
+void runBvhBenchmark(uint32_t objectCount, std::ostream& out);
+
+// Animates every node of a nodeCount-node hierarchy each frame and times
+// the world matrix update into `output` (a mapped buffer of nodeCount
+// matrices): for each 4x4 multiply the CPU has, on one thread and on
+// `jobs`, and with only a few subtrees dirty.
+void runTransformBenchmark(uint32_t nodeCount, glm::mat4* output, JobSystem& jobs, std::ostream& out);
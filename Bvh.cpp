@@ -0,0 +1,459 @@
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+
+namespace {
+constexpr uint32_t BIN_COUNT = 16;
+constexpr uint32_t MAX_LEAF_SIZE = 4;
+// Leaves may hold more than MAX_LEAF_SIZE when splitting them would not pay.
+constexpr uint32_t MAX_SAH_LEAF_SIZE = 16;
+// Cost of visiting an interior node relative to testing one primitive.
+constexpr float TRAVERSAL_COST = 1.0f;
+// Below this depth nodes split at the median, which bounds the depth of the
+// tree (and so the traversal stacks) whatever the SAH would have done.
+constexpr uint32_t MEDIAN_SPLIT_DEPTH = 32;
+constexpr uint32_t STACK_SIZE = 64;
+// A partial rebuild covers at most this share of the primitives.
+constexpr uint32_t PARTIAL_REBUILD_DIVISOR = 4;
+constexpr uint32_t PARTIAL_REBUILD_INTERVAL = 8;
+constexpr float FULL_REBUILD_COST_RATIO = 1.5f;
+
+Aabb emptyBox()
+{
+    return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+
+void grow(Aabb& box, const Aabb& other)
+{
+    box.min = glm::min(box.min, other.min);
+    box.max = glm::max(box.max, other.max);
+}
+
+void grow(Aabb& box, const glm::vec3& point)
+{
+    box.min = glm::min(box.min, point);
+    box.max = glm::max(box.max, point);
+}
+
+float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+{
+    if (min.x > max.x)
+        return 0.0f;
+    glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool overlaps(const Aabb& a, const glm::vec3& min, const glm::vec3& max)
+{
+    return a.min.x <= max.x && a.max.x >= min.x && a.min.y <= max.y && a.max.y >= min.y && a.min.z <= max.z
+        && a.max.z >= min.z;
+}
+
+bool contains(const Aabb& a, const glm::vec3& min, const glm::vec3& max)
+{
+    return a.min.x <= min.x && a.max.x >= max.x && a.min.y <= min.y && a.max.y >= max.y && a.min.z <= min.z
+        && a.max.z >= max.z;
+}
+
+// Tests a box against the planes in `mask`. Returns false if it is outside
+// one of them and clears from `mask` those it is entirely inside of.
+bool boxInFrustum(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max, uint32_t& mask)
+{
+    for (uint32_t p = 0; p < 6; p++) {
+        if (!(mask & (1u << p)))
+            continue;
+        const glm::vec4& plane = frustum.planes[p];
+        // The corners furthest along and against the plane normal.
+        glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+        glm::vec3 negative(plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y, plane.z >= 0.0f ? min.z : max.z);
+        glm::vec3 normal(plane.x, plane.y, plane.z);
+        if (glm::dot(normal, positive) + plane.w < 0.0f)
+            return false;
+        if (glm::dot(normal, negative) + plane.w >= 0.0f)
+            mask &= ~(1u << p);
+    }
+    return true;
+}
+
+// Distance at which the ray enters the box, or FLT_MAX if it misses it
+// within maxDistance. Zero if it starts inside.
+float rayEnters(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const glm::vec3& min,
+    const glm::vec3& max)
+{
+    float enter = 0.0f;
+    float exit = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (min[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (max[axis] - origin[axis]) * inverseDirection[axis];
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return enter <= exit ? enter : FLT_MAX;
+}
+}
+
+void Bvh::build(const std::vector<Aabb>& bounds)
+{
+    auto count = static_cast<uint32_t>(bounds.size());
+    primitiveBounds = bounds;
+    primitiveIndices.resize(count);
+    buildItems.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        buildItems[i] = { bounds[i], (bounds[i].min + bounds[i].max) * 0.5f, i };
+
+    nodes.clear();
+    subtreeEnds.clear();
+    if (count > 0) {
+        nodes.reserve(2 * count - 1);
+        subtreeEnds.reserve(2 * count - 1);
+        buildNode(nodes, subtreeEnds, 0, 0, count, 0);
+    }
+    for (uint32_t i = 0; i < count; i++)
+        primitiveIndices[i] = buildItems[i].primitive;
+    builtAreas.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+        builtAreas[i] = surfaceArea(nodes[i].min, nodes[i].max);
+    builtCost = cost();
+}
+
+uint32_t Bvh::buildNode(std::vector<Node>& out, std::vector<uint32_t>& ends, uint32_t base, uint32_t first, uint32_t count,
+    uint32_t depth)
+{
+    auto index = static_cast<uint32_t>(out.size());
+    out.emplace_back();
+    ends.push_back(0);
+
+    Aabb box = emptyBox();
+    Aabb centroidBox = emptyBox();
+    BuildItem* items = buildItems.data() + first;
+    for (uint32_t i = 0; i < count; i++) {
+        grow(box, items[i].bounds);
+        grow(centroidBox, items[i].centroid);
+    }
+
+    uint32_t splitAxis = 0;
+    uint32_t splitBin = 0;
+    float splitCost = FLT_MAX;
+    if (count > MAX_LEAF_SIZE && depth < MEDIAN_SPLIT_DEPTH) {
+        glm::vec3 scale(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = centroidBox.max[axis] - centroidBox.min[axis];
+            scale[axis] = extent > 0.0f ? BIN_COUNT / extent : 0.0f;
+        }
+        uint32_t binCounts[3][BIN_COUNT] = {};
+        Aabb binBoxes[3][BIN_COUNT];
+        for (auto& axisBoxes : binBoxes)
+            std::fill(std::begin(axisBoxes), std::end(axisBoxes), emptyBox());
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 offset = (items[i].centroid - centroidBox.min) * scale;
+            for (int axis = 0; axis < 3; axis++) {
+                auto bin = std::min(BIN_COUNT - 1, static_cast<uint32_t>(offset[axis]));
+                binCounts[axis][bin]++;
+                grow(binBoxes[axis][bin], items[i].bounds);
+            }
+        }
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            if (scale[axis] == 0.0f)
+                continue;
+            // Sweep from the right for the cost of everything past each
+            // split, then from the left adding the rest.
+            float rightCosts[BIN_COUNT] = {};
+            Aabb right = emptyBox();
+            uint32_t rightCount = 0;
+            for (uint32_t b = BIN_COUNT - 1; b > 0; b--) {
+                grow(right, binBoxes[axis][b]);
+                rightCount += binCounts[axis][b];
+                rightCosts[b - 1] = surfaceArea(right.min, right.max) * rightCount;
+            }
+            Aabb left = emptyBox();
+            uint32_t leftCount = 0;
+            for (uint32_t b = 0; b + 1 < BIN_COUNT; b++) {
+                grow(left, binBoxes[axis][b]);
+                leftCount += binCounts[axis][b];
+                if (leftCount == 0 || leftCount == count)
+                    continue;
+                float cost = surfaceArea(left.min, left.max) * leftCount + rightCosts[b];
+                if (cost < splitCost) {
+                    splitCost = cost;
+                    splitAxis = axis;
+                    splitBin = b;
+                }
+            }
+        }
+    }
+
+    float area = surfaceArea(box.min, box.max);
+    bool leaf = count <= MAX_LEAF_SIZE
+        || (count <= MAX_SAH_LEAF_SIZE && (splitCost == FLT_MAX || TRAVERSAL_COST * area + splitCost >= count * area));
+    if (leaf) {
+        out[index] = { box.min, first, box.max, count | LEAF_BIT };
+        ends[index] = base + index + 1;
+        return base + index;
+    }
+
+    BuildItem* middle = nullptr;
+    if (splitCost != FLT_MAX) {
+        float scale = BIN_COUNT / (centroidBox.max[splitAxis] - centroidBox.min[splitAxis]);
+        middle = std::partition(items, items + count, [&](const BuildItem& item) {
+            auto bin = std::min(BIN_COUNT - 1, static_cast<uint32_t>((item.centroid[splitAxis] - centroidBox.min[splitAxis]) * scale));
+            return bin <= splitBin;
+        });
+    } else {
+        // Too deep, or every centroid in one place: split the longest axis
+        // at the median.
+        glm::vec3 extent = centroidBox.max - centroidBox.min;
+        uint32_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        middle = items + count / 2;
+        std::nth_element(items, middle, items + count,
+            [&](const BuildItem& a, const BuildItem& b) { return a.centroid[axis] < b.centroid[axis]; });
+    }
+    auto leftCount = static_cast<uint32_t>(middle - items);
+
+    // The left child follows directly; the right one after all of the left
+    // subtree.
+    buildNode(out, ends, base, first, leftCount, depth + 1);
+    uint32_t rightChild = buildNode(out, ends, base, first + leftCount, count - leftCount, depth + 1);
+    out[index] = { box.min, rightChild, box.max, count };
+    ends[index] = base + static_cast<uint32_t>(out.size());
+    return base + index;
+}
+
+float Bvh::refit(const std::vector<Aabb>& bounds)
+{
+    if (bounds.size() != primitiveBounds.size()) {
+        throw std::runtime_error("BVH refit with a different primitive count!");
+    }
+    primitiveBounds = bounds;
+
+    // Children always come after their parent.
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& node = nodes[i];
+        Aabb box = emptyBox();
+        if (node.count & LEAF_BIT) {
+            uint32_t count = node.count & ~LEAF_BIT;
+            for (uint32_t p = node.link; p < node.link + count; p++)
+                grow(box, primitiveBounds[primitiveIndices[p]]);
+        } else {
+            grow(box, { nodes[i + 1].min, nodes[i + 1].max });
+            grow(box, { nodes[node.link].min, nodes[node.link].max });
+        }
+        node.min = box.min;
+        node.max = box.max;
+    }
+    return builtCost > 0.0f ? cost() / builtCost : 1.0f;
+}
+
+bool Bvh::rebuildWorstSubtree()
+{
+    uint32_t limit = primitiveCount() / PARTIAL_REBUILD_DIVISOR;
+    uint32_t worst = UINT32_MAX;
+    float worstGrowth = 0.0f;
+    // Depths, so the new subtree keeps to the tree's depth bound.
+    std::vector<uint32_t> depths(nodes.size(), 0);
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+        const Node& node = nodes[i];
+        if (node.count & LEAF_BIT)
+            continue;
+        depths[i + 1] = depths[node.link] = depths[i] + 1;
+        if (node.count > limit)
+            continue;
+        // Absolute growth, since that is what the SAH cost pays for.
+        float growth = surfaceArea(node.min, node.max) - builtAreas[i];
+        if (growth > worstGrowth) {
+            worstGrowth = growth;
+            worst = i;
+        }
+    }
+    if (worst == UINT32_MAX)
+        return false;
+
+    uint32_t first = firstPrimitive(worst);
+    uint32_t count = nodes[worst].count;
+    for (uint32_t i = first; i < first + count; i++) {
+        const Aabb& bounds = primitiveBounds[primitiveIndices[i]];
+        buildItems[i] = { bounds, (bounds.min + bounds.max) * 0.5f, primitiveIndices[i] };
+    }
+    std::vector<Node> subtree;
+    std::vector<uint32_t> ends;
+    buildNode(subtree, ends, worst, first, count, depths[worst]);
+    uint32_t end = subtreeEnds[worst];
+    if (subtree.size() > end - worst)
+        return false;
+    for (uint32_t i = first; i < first + count; i++)
+        primitiveIndices[i] = buildItems[i].primitive;
+
+    std::copy(subtree.begin(), subtree.end(), nodes.begin() + worst);
+    std::copy(ends.begin(), ends.end(), subtreeEnds.begin() + worst);
+    subtreeEnds[worst] = end;
+    for (uint32_t i = worst; i < worst + subtree.size(); i++)
+        builtAreas[i] = surfaceArea(nodes[i].min, nodes[i].max);
+    // Whatever the old subtree used beyond the new one becomes empty leaves.
+    for (auto i = static_cast<uint32_t>(worst + subtree.size()); i < end; i++) {
+        nodes[i] = { glm::vec3(0.0f), 0, glm::vec3(0.0f), LEAF_BIT };
+        subtreeEnds[i] = i + 1;
+        builtAreas[i] = 0.0f;
+    }
+    return true;
+}
+
+void Bvh::update(const std::vector<Aabb>& bounds)
+{
+    if (refit(bounds) > FULL_REBUILD_COST_RATIO) {
+        build(bounds);
+        updatesSincePartialRebuild = 0;
+        fullRebuildCount++;
+        return;
+    }
+    if (++updatesSincePartialRebuild >= PARTIAL_REBUILD_INTERVAL) {
+        updatesSincePartialRebuild = 0;
+        if (rebuildWorstSubtree())
+            partialRebuildCount++;
+    }
+}
+
+float Bvh::cost() const
+{
+    if (nodes.empty())
+        return 0.0f;
+    float total = 0.0f;
+    for (const Node& node : nodes) {
+        float area = surfaceArea(node.min, node.max);
+        total += (node.count & LEAF_BIT) ? area * (node.count & ~LEAF_BIT) : area * TRAVERSAL_COST;
+    }
+    float rootArea = surfaceArea(nodes[0].min, nodes[0].max);
+    return rootArea > 0.0f ? total / rootArea : 0.0f;
+}
+
+uint32_t Bvh::firstPrimitive(uint32_t node) const
+{
+    while (!(nodes[node].count & LEAF_BIT))
+        node++;
+    return nodes[node].link;
+}
+
+void Bvh::appendSubtree(uint32_t node, std::vector<uint32_t>& out) const
+{
+    uint32_t first = firstPrimitive(node);
+    out.insert(out.end(), primitiveIndices.begin() + first, primitiveIndices.begin() + first + (nodes[node].count & ~LEAF_BIT));
+}
+
+void Bvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const
+{
+    if (nodes.empty())
+        return;
+    // Each entry carries the planes its box still straddles; planes a box
+    // is inside of cannot cull anything below it.
+    struct Entry {
+        uint32_t node;
+        uint32_t mask;
+    };
+    Entry stack[STACK_SIZE];
+    uint32_t top = 0;
+    stack[top++] = { 0, 0x3f };
+    while (top > 0) {
+        Entry entry = stack[--top];
+        const Node& node = nodes[entry.node];
+        uint32_t mask = entry.mask;
+        if (!boxInFrustum(frustum, node.min, node.max, mask))
+            continue;
+        if (mask == 0) {
+            appendSubtree(entry.node, out);
+        } else if (node.count & LEAF_BIT) {
+            uint32_t count = node.count & ~LEAF_BIT;
+            for (uint32_t p = node.link; p < node.link + count; p++) {
+                const Aabb& box = primitiveBounds[primitiveIndices[p]];
+                uint32_t primitiveMask = mask;
+                if (boxInFrustum(frustum, box.min, box.max, primitiveMask))
+                    out.push_back(primitiveIndices[p]);
+            }
+        } else {
+            stack[top++] = { node.link, mask };
+            stack[top++] = { entry.node + 1, mask };
+        }
+    }
+}
+
+void Bvh::queryBox(const Aabb& box, std::vector<uint32_t>& out) const
+{
+    if (nodes.empty())
+        return;
+    uint32_t stack[STACK_SIZE];
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        uint32_t index = stack[--top];
+        const Node& node = nodes[index];
+        if (!overlaps(box, node.min, node.max))
+            continue;
+        if (contains(box, node.min, node.max)) {
+            appendSubtree(index, out);
+        } else if (node.count & LEAF_BIT) {
+            uint32_t count = node.count & ~LEAF_BIT;
+            for (uint32_t p = node.link; p < node.link + count; p++) {
+                const Aabb& primitive = primitiveBounds[primitiveIndices[p]];
+                if (overlaps(box, primitive.min, primitive.max))
+                    out.push_back(primitiveIndices[p]);
+            }
+        } else {
+            stack[top++] = node.link;
+            stack[top++] = index + 1;
+        }
+    }
+}
+
+bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+{
+    if (nodes.empty())
+        return false;
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float nearest = maxDistance;
+    uint32_t nearestPrimitive = UINT32_MAX;
+
+    // Children are visited nearest first, and anything entered beyond the
+    // nearest hit so far is skipped when popped.
+    struct Entry {
+        uint32_t node;
+        float distance;
+    };
+    Entry stack[STACK_SIZE];
+    uint32_t top = 0;
+    float rootDistance = rayEnters(origin, inverseDirection, nearest, nodes[0].min, nodes[0].max);
+    if (rootDistance != FLT_MAX)
+        stack[top++] = { 0, rootDistance };
+    while (top > 0) {
+        Entry entry = stack[--top];
+        if (entry.distance > nearest)
+            continue;
+        const Node& node = nodes[entry.node];
+        if (node.count & LEAF_BIT) {
+            uint32_t count = node.count & ~LEAF_BIT;
+            for (uint32_t p = node.link; p < node.link + count; p++) {
+                const Aabb& box = primitiveBounds[primitiveIndices[p]];
+                float distance = rayEnters(origin, inverseDirection, nearest, box.min, box.max);
+                if (distance <= nearest && distance != FLT_MAX) {
+                    nearest = distance;
+                    nearestPrimitive = primitiveIndices[p];
+                }
+            }
+            continue;
+        }
+        uint32_t first = entry.node + 1;
+        uint32_t second = node.link;
+        float firstDistance = rayEnters(origin, inverseDirection, nearest, nodes[first].min, nodes[first].max);
+        float secondDistance = rayEnters(origin, inverseDirection, nearest, nodes[second].min, nodes[second].max);
+        if (secondDistance < firstDistance) {
+            std::swap(first, second);
+            std::swap(firstDistance, secondDistance);
+        }
+        if (secondDistance != FLT_MAX)
+            stack[top++] = { second, secondDistance };
+        if (firstDistance != FLT_MAX)
+            stack[top++] = { first, firstDistance };
+    }
+    if (nearestPrimitive == UINT32_MAX)
+        return false;
+    hit = { nearestPrimitive, nearest };
+    return true;
+}
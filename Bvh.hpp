@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Scene.hpp"
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct RayHit {
+    uint32_t primitive;
+    float distance;
+};
+
+// Bounding volume hierarchy over the boxes of a flat list of primitives
+// (scene objects here), answering frustum, box and ray queries in time
+// logarithmic in the primitive count for scenes that are mostly static.
+//
+// Built top-down with the binned surface area heuristic. Nodes are 32 bytes
+// in depth-first order: a left child directly follows its parent, so a
+// traversal mostly walks forward through memory, and every subtree is one
+// contiguous range of nodes over one contiguous range of primitives.
+//
+// When primitives move, refit() recomputes the boxes bottom-up without
+// changing the tree. The tree slowly degrades as primitives drift from
+// where it was built; rebuildWorstSubtree() rebuilds the part that degraded
+// most in place, and a full build() resets everything.
+class Bvh {
+public:
+    void build(const std::vector<Aabb>& bounds);
+    // `bounds` has the primitives of the last build in the same order.
+    // Returns the SAH cost relative to what the last build produced, which
+    // grows as the tree degrades.
+    float refit(const std::vector<Aabb>& bounds);
+    // Rebuilds the subtree whose surface area grew the most relative to when
+    // it was built. Returns false if none has degraded, or if the new
+    // subtree would not fit in place of the old one.
+    bool rebuildWorstSubtree();
+    // Refits, then keeps the tree in shape: a partial rebuild every few
+    // calls, and a full build once the cost has grown by half.
+    void update(const std::vector<Aabb>& bounds);
+
+    // Appends every primitive whose box is at least partly inside.
+    void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+    void queryBox(const Aabb& box, std::vector<uint32_t>& out) const;
+    // Nearest box the ray enters within maxDistance; direction need not be
+    // normalized, distances are in units of its length.
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;
+
+    uint32_t nodeCount() const { return static_cast<uint32_t>(nodes.size()); }
+    uint32_t primitiveCount() const { return static_cast<uint32_t>(primitiveIndices.size()); }
+    float cost() const;
+    uint32_t fullRebuilds() const { return fullRebuildCount; }
+    uint32_t partialRebuilds() const { return partialRebuildCount; }
+
+private:
+    static constexpr uint32_t LEAF_BIT = 0x80000000u;
+
+    struct Node {
+        glm::vec3 min;
+        // Leaf: first entry in primitiveIndices. Interior: right child.
+        uint32_t link;
+        glm::vec3 max;
+        // Primitives below the node; LEAF_BIT set on leaves.
+        uint32_t count;
+    };
+
+    uint32_t buildNode(std::vector<Node>& out, std::vector<uint32_t>& ends, uint32_t base, uint32_t first, uint32_t count,
+        uint32_t depth);
+    uint32_t firstPrimitive(uint32_t node) const;
+    void appendSubtree(uint32_t node, std::vector<uint32_t>& out) const;
+
+    std::vector<Node> nodes;
+    // Per node, kept apart so traversals only touch nodes: one past the last
+    // node of its subtree (which may end in unused nodes after a partial
+    // rebuild), and its surface area when it was built.
+    std::vector<uint32_t> subtreeEnds;
+    std::vector<float> builtAreas;
+    std::vector<uint32_t> primitiveIndices;
+    std::vector<Aabb> primitiveBounds;
+    // Build scratch, one per entry of primitiveIndices: the primitive's box
+    // and centroid stored with it, so the build streams through one array
+    // instead of gathering through the indices.
+    struct BuildItem {
+        Aabb bounds;
+        glm::vec3 centroid;
+        uint32_t primitive;
+    };
+    std::vector<BuildItem> buildItems;
+    float builtCost = 0.0f;
+    uint32_t updatesSincePartialRebuild = 0;
+    uint32_t fullRebuildCount = 0;
+    uint32_t partialRebuildCount = 0;
+};
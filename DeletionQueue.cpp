@@ -0,0 +1,26 @@
+#include "DeletionQueue.hpp"
+
+void DeletionQueue::beginFrame(uint64_t frame, uint64_t completedFrame)
+{
+    currentFrame = frame;
+    // Entries are pushed in frame order, so the completed ones are a prefix.
+    while (!entries.empty() && entries.front().frame <= completedFrame) {
+        auto destroy = std::move(entries.front().destroy);
+        entries.pop_front();
+        destroy();
+    }
+}
+
+void DeletionQueue::push(std::function<void()> destroy)
+{
+    entries.push_back({ currentFrame, std::move(destroy) });
+}
+
+void DeletionQueue::flush()
+{
+    while (!entries.empty()) {
+        auto destroy = std::move(entries.front().destroy);
+        entries.pop_front();
+        destroy();
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Destruction deferred until the GPU is done with an object, in place of
+// draining the device. Frames are numbered as they are recorded; whatever is
+// pushed while frame N is current runs once frame N is known to be complete,
+// which covers any earlier frame that used the object too.
+//
+// Only the thread that runs the frame loop may use it.
+class DeletionQueue {
+public:
+    // Makes `frame` current and runs everything pushed during frames up to
+    // `completedFrame`, which the GPU has finished.
+    void beginFrame(uint64_t frame, uint64_t completedFrame);
+    void push(std::function<void()> destroy);
+    // Runs everything still pending; the device must be idle.
+    void flush();
+
+    size_t pending() const { return entries.size(); }
+
+private:
+    struct Entry {
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+
+    std::deque<Entry> entries;
+    uint64_t currentFrame = 0;
+};
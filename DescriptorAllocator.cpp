@@ -0,0 +1,65 @@
+#include "DescriptorAllocator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+const uint32_t MAX_POOL_SETS = 4096;
+}
+
+void DescriptorAllocator::init(VkDevice vkDevice, std::vector<PoolRatio> poolRatios, uint32_t initialSets)
+{
+    device = vkDevice;
+    ratios = std::move(poolRatios);
+    nextPoolSets = std::max(initialSets, 1u);
+    pools.push_back(createPool(nextPoolSets));
+}
+
+void DescriptorAllocator::destroy()
+{
+    for (auto pool : pools)
+        vkDestroyDescriptorPool(device, pool, nullptr);
+    pools.clear();
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pools.back();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+    VkDescriptorSet set;
+    VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        // The full pool stays alive for the sets already in it.
+        pools.push_back(createPool(nextPoolSets));
+        allocInfo.descriptorPool = pools.back();
+        result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+    }
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor set!");
+    }
+    return set;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t setCount)
+{
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (const auto& ratio : ratios) {
+        auto count = static_cast<uint32_t>(std::ceil(ratio.perSet * static_cast<float>(setCount)));
+        sizes.push_back({ ratio.type, std::max(count, 1u) });
+    }
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+    poolInfo.pPoolSizes = sizes.data();
+    poolInfo.maxSets = setCount;
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+    nextPoolSets = std::min(setCount * 2, MAX_POOL_SETS);
+    return pool;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// Descriptor sets from a chain of pools. When the current pool runs out,
+// another one twice its size (up to a cap) is started instead of failing,
+// so callers need not know up front how many sets of which kinds there will
+// be. Sets are never freed one by one; the pools go away together.
+class DescriptorAllocator {
+public:
+    // How many descriptors of a type to reserve per set in each pool.
+    struct PoolRatio {
+        VkDescriptorType type;
+        float perSet;
+    };
+
+    void init(VkDevice device, std::vector<PoolRatio> ratios, uint32_t initialSets = 16);
+    void destroy();
+
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+    size_t poolCount() const { return pools.size(); }
+
+private:
+    VkDescriptorPool createPool(uint32_t setCount);
+
+    VkDevice device = VK_NULL_HANDLE;
+    std::vector<PoolRatio> ratios;
+    uint32_t nextPoolSets = 0;
+    // The last one is the pool allocations come from.
+    std::vector<VkDescriptorPool> pools;
+};
@@ -0,0 +1,171 @@
+#include "DescriptorHeap.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "DeletionQueue.hpp"
+
+namespace {
+const std::array<VkDescriptorType, DescriptorHeap::KIND_COUNT> DESCRIPTOR_TYPES = {
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+const VkShaderStageFlags HEAP_STAGES = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+}
+
+bool DescriptorHeap::isSupported(const VkPhysicalDeviceDescriptorIndexingFeatures& features)
+{
+    // Sampler descriptors fall under the sampled image update-after-bind
+    // feature.
+    return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound
+        && features.descriptorBindingStorageBufferUpdateAfterBind && features.descriptorBindingSampledImageUpdateAfterBind
+        && features.shaderStorageBufferArrayNonUniformIndexing && features.shaderSampledImageArrayNonUniformIndexing;
+}
+
+void DescriptorHeap::init(VkPhysicalDevice physicalDevice, VkDevice vkDevice, DeletionQueue& queue, Capacity requested)
+{
+    device = vkDevice;
+    deletionQueue = &queue;
+
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties {};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    arrays[0].capacity = std::min({ requested.storageBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+        indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+    arrays[1].capacity = std::min({ requested.sampledImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+    arrays[2].capacity = std::min({ requested.samplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+        indexingProperties.maxDescriptorSetUpdateAfterBindSamplers });
+
+    std::array<VkDescriptorSetLayoutBinding, KIND_COUNT> bindings {};
+    std::array<VkDescriptorBindingFlags, KIND_COUNT> bindingFlags {};
+    std::array<VkDescriptorPoolSize, KIND_COUNT> poolSizes {};
+    for (uint32_t i = 0; i < KIND_COUNT; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = DESCRIPTOR_TYPES[i];
+        bindings[i].descriptorCount = arrays[i].capacity;
+        bindings[i].stageFlags = HEAP_STAGES;
+        // Partially bound: slots nobody indexes may hold no descriptor.
+        bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+        poolSizes[i] = { DESCRIPTOR_TYPES[i], arrays[i].capacity };
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = KIND_COUNT;
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = KIND_COUNT;
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor heap layout!");
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.poolSizeCount = KIND_COUNT;
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor heap pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &setLayout;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor heap set!");
+    }
+}
+
+void DescriptorHeap::destroy()
+{
+    if (pool == VK_NULL_HANDLE)
+        return;
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    pool = VK_NULL_HANDLE;
+    setLayout = VK_NULL_HANDLE;
+    descriptorSet = VK_NULL_HANDLE;
+    arrays = {};
+}
+
+void DescriptorHeap::bind(VkCommandBuffer cbuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet) const
+{
+    vkCmdBindDescriptorSets(cbuffer, bindPoint, pipelineLayout, firstSet, 1, &descriptorSet, 0, nullptr);
+}
+
+DescriptorIndex DescriptorHeap::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    DescriptorIndex index = allocateIndex(Kind::StorageBuffer);
+    VkDescriptorBufferInfo bufferInfo { buffer, offset, range };
+    write(Kind::StorageBuffer, index, &bufferInfo, nullptr);
+    return index;
+}
+
+DescriptorIndex DescriptorHeap::addSampledImage(VkImageView view, VkImageLayout layout)
+{
+    DescriptorIndex index = allocateIndex(Kind::SampledImage);
+    VkDescriptorImageInfo imageInfo { VK_NULL_HANDLE, view, layout };
+    write(Kind::SampledImage, index, nullptr, &imageInfo);
+    return index;
+}
+
+DescriptorIndex DescriptorHeap::addSampler(VkSampler sampler)
+{
+    DescriptorIndex index = allocateIndex(Kind::Sampler);
+    VkDescriptorImageInfo imageInfo { sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+    write(Kind::Sampler, index, nullptr, &imageInfo);
+    return index;
+}
+
+void DescriptorHeap::release(Kind kind, DescriptorIndex index)
+{
+    IndexArray& array = arrays[static_cast<uint32_t>(kind)];
+    deletionQueue->push([&array, index]() { array.freeList.push_back(index); });
+}
+
+uint32_t DescriptorHeap::used(Kind kind) const
+{
+    const IndexArray& array = arrays[static_cast<uint32_t>(kind)];
+    return array.next - static_cast<uint32_t>(array.freeList.size());
+}
+
+DescriptorIndex DescriptorHeap::allocateIndex(Kind kind)
+{
+    IndexArray& array = arrays[static_cast<uint32_t>(kind)];
+    if (!array.freeList.empty()) {
+        DescriptorIndex index = array.freeList.back();
+        array.freeList.pop_back();
+        return index;
+    }
+    if (array.next == array.capacity) {
+        throw std::runtime_error("descriptor heap is full!");
+    }
+    return array.next++;
+}
+
+void DescriptorHeap::write(Kind kind, DescriptorIndex index, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo)
+{
+    auto binding = static_cast<uint32_t>(kind);
+    VkWriteDescriptorSet descriptorWrite {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = binding;
+    descriptorWrite.dstArrayElement = index;
+    descriptorWrite.descriptorType = DESCRIPTOR_TYPES[binding];
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = bufferInfo;
+    descriptorWrite.pImageInfo = imageInfo;
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class DeletionQueue;
+
+// Index of a descriptor in one of the heap's arrays, as shaders receive it.
+using DescriptorIndex = uint32_t;
+
+// One large descriptor set of update-after-bind arrays (Vulkan 1.2
+// descriptor indexing): storage buffers, sampled images and samplers, each at
+// its own binding. The set is bound once per command buffer; draws pass the
+// indices of what they use instead of binding sets of their own, and new
+// descriptors may be written while earlier frames still use the set.
+//
+// Indices come from a free list per array. A released index is only reused
+// once the frames that may still read it are complete.
+class DescriptorHeap {
+public:
+    enum class Kind : uint32_t {
+        StorageBuffer,
+        SampledImage,
+        Sampler,
+    };
+    static constexpr uint32_t KIND_COUNT = 3;
+
+    // Requested array sizes, clamped to the device's update-after-bind limits.
+    struct Capacity {
+        uint32_t storageBuffers = 65536;
+        uint32_t sampledImages = 65536;
+        uint32_t samplers = 1024;
+    };
+
+    // Whether the device has everything the heap needs. `features` must be
+    // queried from the device; enable it as-is when this returns true.
+    static bool isSupported(const VkPhysicalDeviceDescriptorIndexingFeatures& features);
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue, Capacity capacity);
+    void destroy();
+
+    VkDescriptorSetLayout layout() const { return setLayout; }
+    VkDescriptorSet set() const { return descriptorSet; }
+    // Binds the heap as set `firstSet` of `pipelineLayout`.
+    void bind(VkCommandBuffer cbuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t firstSet) const;
+
+    DescriptorIndex addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    DescriptorIndex addSampledImage(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    DescriptorIndex addSampler(VkSampler sampler);
+    // The descriptor stays valid for frames already recorded; the index is
+    // handed out again once they are complete.
+    void release(Kind kind, DescriptorIndex index);
+
+    uint32_t used(Kind kind) const;
+    uint32_t capacity(Kind kind) const { return arrays[static_cast<uint32_t>(kind)].capacity; }
+
+private:
+    struct IndexArray {
+        uint32_t capacity = 0;
+        // Indices below `next` have been handed out at least once.
+        uint32_t next = 0;
+        std::vector<DescriptorIndex> freeList;
+    };
+
+    DescriptorIndex allocateIndex(Kind kind);
+    void write(Kind kind, DescriptorIndex index, const VkDescriptorBufferInfo* bufferInfo, const VkDescriptorImageInfo* imageInfo);
+
+    VkDevice device = VK_NULL_HANDLE;
+    DeletionQueue* deletionQueue = nullptr;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    std::array<IndexArray, KIND_COUNT> arrays;
+};
@@ -0,0 +1,144 @@
+#include "FrameProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+
+namespace {
+const char* phaseName(FramePhase phase)
+{
+    switch (phase) {
+    case FramePhase::Frame:
+        return "frame";
+    case FramePhase::FenceWait:
+        return "fence_wait";
+    case FramePhase::Acquire:
+        return "acquire";
+    case FramePhase::Record:
+        return "record";
+    case FramePhase::UniformUpdate:
+        return "ubo_update";
+    case FramePhase::Submit:
+        return "submit";
+    case FramePhase::Present:
+        return "present";
+    case FramePhase::GpuRenderPass:
+        return "gpu_render_pass";
+    case FramePhase::GpuCompute:
+        return "gpu_particles";
+    case FramePhase::Pacing:
+        return "pacing_wait";
+    case FramePhase::InputToSubmit:
+        return "input_to_submit";
+    case FramePhase::QueueSort:
+        return "queue_sort";
+    case FramePhase::BvhQuery:
+        return "bvh_query";
+    case FramePhase::Count:
+        break;
+    }
+    return "unknown";
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void writeJsonString(std::ostream& out, const std::string& value)
+{
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\')
+            out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+}
+
+TimingSummary summarize(std::vector<double> samples)
+{
+    TimingSummary summary;
+    if (samples.empty())
+        return summary;
+    std::sort(samples.begin(), samples.end());
+    summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+    summary.p50 = percentile(samples, 50.0);
+    summary.p95 = percentile(samples, 95.0);
+    summary.p99 = percentile(samples, 99.0);
+    summary.max = samples.back();
+    return summary;
+}
+
+void writeJsonSummary(std::ostream& out, const TimingSummary& summary)
+{
+    out << "{\"mean\": " << summary.mean
+        << ", \"p50\": " << summary.p50
+        << ", \"p95\": " << summary.p95
+        << ", \"p99\": " << summary.p99
+        << ", \"max\": " << summary.max << "}";
+}
+
+void FrameProfiler::begin(size_t frameCount)
+{
+    active = true;
+    for (auto& phaseSamples : samples) {
+        phaseSamples.clear();
+        phaseSamples.reserve(frameCount);
+    }
+}
+
+void FrameProfiler::record(FramePhase phase, double milliseconds)
+{
+    if (active)
+        samples[static_cast<size_t>(phase)].push_back(milliseconds);
+}
+
+size_t FrameProfiler::sampleCount(FramePhase phase) const
+{
+    return samples[static_cast<size_t>(phase)].size();
+}
+
+void FrameProfiler::printReport(std::ostream& out) const
+{
+    out << std::left << std::setw(18) << "phase (ms)" << std::right
+        << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p95"
+        << std::setw(10) << "p99" << std::setw(10) << "max" << '\n';
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < samples.size(); i++) {
+        if (samples[i].empty())
+            continue;
+        auto summary = summarize(samples[i]);
+        out << std::left << std::setw(18) << phaseName(static_cast<FramePhase>(i)) << std::right
+            << std::setw(10) << summary.mean << std::setw(10) << summary.p50 << std::setw(10) << summary.p95
+            << std::setw(10) << summary.p99 << std::setw(10) << summary.max << '\n';
+    }
+    out << std::defaultfloat;
+}
+
+void FrameProfiler::writeJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& metadata) const
+{
+    out << "{\n";
+    for (const auto& [key, value] : metadata) {
+        out << "  ";
+        writeJsonString(out, key);
+        out << ": ";
+        writeJsonString(out, value);
+        out << ",\n";
+    }
+    out << "  \"frames\": " << sampleCount(FramePhase::Frame) << ",\n";
+    out << "  \"unit\": \"ms\",\n";
+    out << "  \"phases\": {";
+    bool first = true;
+    for (size_t i = 0; i < samples.size(); i++) {
+        if (samples[i].empty())
+            continue;
+        out << (first ? "\n" : ",\n") << "    \"" << phaseName(static_cast<FramePhase>(i)) << "\": ";
+        writeJsonSummary(out, summarize(samples[i]));
+        first = false;
+    }
+    out << "\n  }\n}\n";
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct TimingSummary {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// Nearest-rank percentiles over a copy of the samples.
+TimingSummary summarize(std::vector<double> samples);
+
+void writeJsonSummary(std::ostream& out, const TimingSummary& summary);
+
+enum class FramePhase {
+    Frame,
+    FenceWait,
+    Acquire,
+    Record,
+    UniformUpdate,
+    Submit,
+    Present,
+    GpuRenderPass,
+    GpuCompute,
+    // Time the frame limiter held the frame back before it started.
+    Pacing,
+    // From sampling the camera input to the submission that uses it.
+    InputToSubmit,
+    // Radix sort of the render queue (part of UniformUpdate).
+    QueueSort,
+    // BVH frustum query for --bvh (part of UniformUpdate).
+    BvhQuery,
+    Count,
+};
+
+// Collects one millisecond sample per phase per frame while a benchmark is
+// running. Disabled profilers ignore everything, so the frame loop can time
+// unconditionally.
+class FrameProfiler {
+public:
+    void begin(size_t frameCount);
+    bool enabled() const { return active; }
+    void record(FramePhase phase, double milliseconds);
+    size_t sampleCount(FramePhase phase) const;
+    TimingSummary summary(FramePhase phase) const { return summarize(samples[static_cast<size_t>(phase)]); }
+
+    void printReport(std::ostream& out) const;
+    void writeJson(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& metadata) const;
+
+private:
+    bool active = false;
+    std::array<std::vector<double>, static_cast<size_t>(FramePhase::Count)> samples;
+};
+
+class ScopedPhaseTimer {
+public:
+    ScopedPhaseTimer(FrameProfiler& profiler, FramePhase phase)
+        : profiler(profiler)
+        , phase(phase)
+        , start(std::chrono::steady_clock::now())
+    {
+    }
+    ~ScopedPhaseTimer()
+    {
+        if (profiler.enabled()) {
+            auto end = std::chrono::steady_clock::now();
+            profiler.record(phase, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+    }
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+private:
+    FrameProfiler& profiler;
+    FramePhase phase;
+    std::chrono::steady_clock::time_point start;
+};
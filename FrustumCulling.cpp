@@ -0,0 +1,95 @@
+#include "FrustumCulling.hpp"
+
+namespace {
+uint32_t cullScalar(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t first, uint32_t end, uint32_t* visible)
+{
+    uint32_t count = 0;
+    for (uint32_t i = first; i < end; i++) {
+        glm::vec3 center(spheres.x[i], spheres.y[i], spheres.z[i]);
+        if (sphereInFrustum(frustum, center, spheres.radius[i]))
+            visible[count++] = i;
+    }
+    return count;
+}
+
+#if SIMD_X86
+// Appends base + the index of every set bit of mask.
+inline uint32_t appendMask(uint32_t mask, uint32_t base, uint32_t* visible)
+{
+    uint32_t count = 0;
+    while (mask) {
+        visible[count++] = base + static_cast<uint32_t>(__builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+uint32_t cullSse(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t first, uint32_t end, uint32_t* visible)
+{
+    __m128 planes[6][4];
+    for (size_t p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++)
+            planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+    }
+    uint32_t count = 0;
+    uint32_t i = first;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(&spheres.x[i]);
+        __m128 y = _mm_loadu_ps(&spheres.y[i]);
+        __m128 z = _mm_loadu_ps(&spheres.z[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& plane : planes) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane[0], x), _mm_mul_ps(plane[1], y)),
+                _mm_add_ps(_mm_mul_ps(plane[2], z), plane[3]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        count += appendMask(static_cast<uint32_t>(_mm_movemask_ps(inside)), i, visible + count);
+    }
+    return count + cullScalar(frustum, spheres, i, end, visible + count);
+}
+
+SIMD_TARGET_AVX2 uint32_t cullAvx2(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t first, uint32_t end, uint32_t* visible)
+{
+    __m256 planes[6][4];
+    for (size_t p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++)
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+    }
+    uint32_t count = 0;
+    uint32_t i = first;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+        __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+        __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& plane : planes) {
+            __m256 distance = _mm256_fmadd_ps(plane[0], x, _mm256_fmadd_ps(plane[1], y, _mm256_fmadd_ps(plane[2], z, plane[3])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+        count += appendMask(static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, visible + count);
+    }
+    return count + cullSse(frustum, spheres, i, end, visible + count);
+}
+#endif
+}
+
+uint32_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t first, uint32_t end, uint32_t* visible,
+    SimdLevel level)
+{
+#if SIMD_X86
+    switch (level) {
+    case SimdLevel::Avx2:
+        return cullAvx2(frustum, spheres, first, end, visible);
+    case SimdLevel::Avx:
+    case SimdLevel::Sse:
+        return cullSse(frustum, spheres, first, end, visible);
+    case SimdLevel::Scalar:
+        break;
+    }
+#else
+    (void)level;
+#endif
+    return cullScalar(frustum, spheres, first, end, visible);
+}
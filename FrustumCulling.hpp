@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Scene.hpp"
+#include "Simd.hpp"
+
+// Bounding spheres as four parallel arrays, so a kernel loads eight centers'
+// x (or y, z, radius) with one instruction.
+struct BoundingSpheres {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    void resize(uint32_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        radius.resize(count);
+    }
+    void set(uint32_t index, const glm::vec3& center, float r)
+    {
+        x[index] = center.x;
+        y[index] = center.y;
+        z[index] = center.z;
+        radius[index] = r;
+    }
+    uint32_t size() const { return static_cast<uint32_t>(x.size()); }
+};
+
+// Tests spheres [first, end) against the frustum, the same test as
+// sphereInFrustum, and writes the indices of those at least partly inside
+// to `visible` in ascending order. Returns how many were written; `visible`
+// needs room for end - first. AVX2 tests eight spheres at a time, SSE four
+// (AVX alone gains nothing here and uses the SSE kernel).
+uint32_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t first, uint32_t end, uint32_t* visible,
+    SimdLevel level);
@@ -0,0 +1,186 @@
+#include "JobSystem.hpp"
+
+#include <utility>
+
+namespace {
+// How often an idle worker yields and re-checks every queue before it goes
+// to sleep; spawning a job is much cheaper when nobody has to be woken.
+const uint32_t IDLE_SPINS = 64;
+
+struct ThreadSlot {
+    const JobSystem* owner = nullptr;
+    uint32_t index = 0;
+};
+thread_local ThreadSlot threadSlot;
+}
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    queues.reserve(workerCount + 1);
+    for (uint32_t i = 0; i < workerCount + 1; i++) {
+        queues.push_back(std::make_unique<Queue>());
+        queues.back()->pool = std::vector<Job>(MAX_JOBS_PER_THREAD);
+    }
+    threads.reserve(workerCount);
+    for (uint32_t i = 1; i <= workerCount; i++)
+        threads.emplace_back(&JobSystem::workerMain, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+Job* JobSystem::create(std::function<void()> task, Job* parent)
+{
+    // Only the owning thread hands out its slots, so no lock is needed here.
+    // Jobs mostly finish in creation order, so the next slot is almost
+    // always free; live ones are skipped, and a full ring waits for one.
+    uint32_t thread = currentThread();
+    Queue& queue = *queues[thread];
+    Job* job = nullptr;
+    while (!job) {
+        for (uint32_t i = 0; i < MAX_JOBS_PER_THREAD && !job; i++) {
+            Job* candidate = &queue.pool[queue.poolNext++ % MAX_JOBS_PER_THREAD];
+            if (candidate->unfinished.load(std::memory_order_acquire) == 0)
+                job = candidate;
+        }
+        if (!job && !runOne(thread))
+            std::this_thread::yield();
+    }
+    job->task = std::move(task);
+    job->parent = parent;
+    job->unfinished.store(1, std::memory_order_relaxed);
+    if (parent)
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::run(Job* job)
+{
+    Queue& queue = *queues[currentThread()];
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+    queuedJobs.fetch_add(1);
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard lock(sleepMutex);
+        wake.notify_one();
+    }
+}
+
+void JobSystem::wait(const Job* job)
+{
+    uint32_t thread = currentThread();
+    while (job->unfinished.load(std::memory_order_acquire) > 0) {
+        if (!runOne(thread))
+            std::this_thread::yield();
+    }
+
+    std::lock_guard lock(failureMutex);
+    if (failure)
+        std::rethrow_exception(std::exchange(failure, nullptr));
+}
+
+uint32_t JobSystem::currentThread() const
+{
+    // Any thread that is not one of our workers is treated as the main
+    // thread, which owns slot 0.
+    return threadSlot.owner == this ? threadSlot.index : 0;
+}
+
+Job* JobSystem::pop(uint32_t thread)
+{
+    Queue& queue = *queues[thread];
+    std::lock_guard lock(queue.mutex);
+    if (queue.jobs.empty())
+        return nullptr;
+    Job* job = queue.jobs.back();
+    queue.jobs.pop_back();
+    queuedJobs.fetch_sub(1);
+    return job;
+}
+
+Job* JobSystem::steal(uint32_t thief)
+{
+    auto count = static_cast<uint32_t>(queues.size());
+    for (uint32_t i = 1; i < count; i++) {
+        Queue& queue = *queues[(thief + i) % count];
+        std::lock_guard lock(queue.mutex);
+        if (queue.jobs.empty())
+            continue;
+        Job* job = queue.jobs.front();
+        queue.jobs.pop_front();
+        queuedJobs.fetch_sub(1);
+        return job;
+    }
+    return nullptr;
+}
+
+bool JobSystem::runOne(uint32_t thread)
+{
+    Job* job = pop(thread);
+    if (!job)
+        job = steal(thread);
+    if (job)
+        execute(job);
+    return job != nullptr;
+}
+
+void JobSystem::execute(Job* job)
+{
+    if (job->task) {
+        try {
+            job->task();
+        } catch (...) {
+            std::lock_guard lock(failureMutex);
+            if (!failure)
+                failure = std::current_exception();
+        }
+    }
+    finish(job);
+}
+
+void JobSystem::finish(Job* job)
+{
+    // The parent is read before the count drops: once it reaches zero the
+    // slot may be handed out again and must not be touched.
+    while (job) {
+        Job* parent = job->parent;
+        if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            break;
+        job = parent;
+    }
+}
+
+void JobSystem::workerMain(uint32_t thread)
+{
+    threadSlot = { this, thread };
+    uint32_t idleSpins = 0;
+    while (!stopping.load()) {
+        if (runOne(thread)) {
+            idleSpins = 0;
+            continue;
+        }
+        if (++idleSpins < IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // run() reads sleepingWorkers after publishing queuedJobs, and we
+        // check queuedJobs after publishing sleepingWorkers, so at least one
+        // side sees the other and no wakeup is lost.
+        std::unique_lock lock(sleepMutex);
+        sleepingWorkers.fetch_add(1);
+        wake.wait(lock, [this] { return stopping.load() || queuedJobs.load() > 0; });
+        sleepingWorkers.fetch_sub(1);
+        idleSpins = 0;
+    }
+}
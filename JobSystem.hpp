@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A unit of work. A job counts as finished once its own task has run and
+// every child created under it has finished, so waiting on a parent waits on
+// the whole subtree.
+struct Job {
+    std::function<void()> task;
+    Job* parent = nullptr;
+    std::atomic<int32_t> unfinished { 0 };
+};
+
+// Work-stealing scheduler. Every thread, the calling (main) thread included,
+// owns a deque of runnable jobs: it pushes and pops at the back, so freshly
+// spawned children run hot in its cache, while idle threads steal from the
+// front of the others. wait() never blocks while there is work anywhere; the
+// waiting thread keeps executing jobs until the one it waits on is done.
+//
+// Jobs come from per-thread rings of MAX_JOBS_PER_THREAD entries. A slot is
+// handed out again only once its job has finished; a thread whose ring is
+// full runs other jobs until one of its own finishes.
+class JobSystem {
+public:
+    static constexpr uint32_t MAX_JOBS_PER_THREAD = 4096;
+
+    // workerCount threads are started in addition to the calling thread, which
+    // takes part in the work whenever it waits.
+    explicit JobSystem(uint32_t workerCount);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    uint32_t threadCount() const { return static_cast<uint32_t>(queues.size()); }
+    // About eight chunks per thread, so stealing can even out uneven chunks,
+    // but never chunks so small that scheduling dominates.
+    uint32_t grainSize(uint32_t count, uint32_t minGrain = 64) const
+    {
+        uint32_t chunks = threadCount() * 8;
+        return std::max(minGrain, (count + chunks - 1) / chunks);
+    }
+
+    // The child relationship is recorded at creation, so children must be
+    // created before their parent has finished (normally from inside the
+    // parent's task, or before the parent is run).
+    Job* create(std::function<void()> task, Job* parent = nullptr);
+    void run(Job* job);
+    // Also rethrows the first exception any task has thrown since the last
+    // wait, once the job is done.
+    void wait(const Job* job);
+
+    // Splits [0, count) into chunks of at most grainSize items, runs
+    // body(first, end) for each chunk as a child of one root job and waits.
+    template <typename Body>
+    void parallelFor(uint32_t count, uint32_t grainSize, const Body& body, Job* parent = nullptr)
+    {
+        Job* root = create(nullptr, parent);
+        grainSize = grainSize == 0 ? 1 : grainSize;
+        for (uint32_t first = 0; first < count; first += grainSize) {
+            uint32_t end = count - first < grainSize ? count : first + grainSize;
+            run(create([&body, first, end] { body(first, end); }, root));
+        }
+        run(root);
+        wait(root);
+    }
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Job*> jobs;
+        std::vector<Job> pool;
+        uint32_t poolNext = 0;
+    };
+
+    uint32_t currentThread() const;
+    Job* pop(uint32_t thread);
+    Job* steal(uint32_t thief);
+    // Runs one queued job, its own or a stolen one; false if there was none.
+    bool runOne(uint32_t thread);
+    void execute(Job* job);
+    void finish(Job* job);
+    void workerMain(uint32_t thread);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> queuedJobs { 0 };
+    std::atomic<uint32_t> sleepingWorkers { 0 };
+    std::atomic<bool> stopping { false };
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::mutex failureMutex;
+    std::exception_ptr failure;
+};
@@ -0,0 +1,239 @@
+#include "MemoryAllocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+MemoryBlock::MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, void* mapped)
+    : memory(memory)
+    , size(size)
+    , memoryTypeIndex(memoryTypeIndex)
+    , mapped(mapped)
+{
+    insertFreeRange(0, size);
+}
+
+bool MemoryBlock::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, Allocation& allocation)
+{
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+    VkDeviceSize offset = 0;
+    // Best fit: the smallest free range that still holds the request once its
+    // start is aligned.
+    auto it = freeBySize.lower_bound(allocationSize);
+    for (; it != freeBySize.end(); ++it) {
+        offset = alignUp(it->second, alignment);
+        if (offset - it->second + allocationSize <= it->first)
+            break;
+    }
+    if (it == freeBySize.end())
+        return false;
+
+    VkDeviceSize rangeOffset = it->second;
+    VkDeviceSize rangeEnd = it->second + it->first;
+    eraseFreeRange(freeByOffset.find(rangeOffset));
+    if (offset > rangeOffset)
+        insertFreeRange(rangeOffset, offset - rangeOffset);
+    if (offset + allocationSize < rangeEnd)
+        insertFreeRange(offset + allocationSize, rangeEnd - offset - allocationSize);
+
+    usedBytes += allocationSize;
+    allocation.memory = memory;
+    allocation.offset = offset;
+    allocation.size = allocationSize;
+    allocation.mapped = mapped ? static_cast<char*>(mapped) + offset : nullptr;
+    allocation.block = this;
+    return true;
+}
+
+void MemoryBlock::free(const Allocation& allocation)
+{
+    usedBytes -= allocation.size;
+
+    VkDeviceSize offset = allocation.offset;
+    VkDeviceSize rangeSize = allocation.size;
+    auto next = freeByOffset.lower_bound(offset);
+    if (next != freeByOffset.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            rangeSize += prev->second;
+            eraseFreeRange(prev);
+        }
+    }
+    next = freeByOffset.lower_bound(offset + rangeSize);
+    if (next != freeByOffset.end() && next->first == offset + rangeSize) {
+        rangeSize += next->second;
+        eraseFreeRange(next);
+    }
+    insertFreeRange(offset, rangeSize);
+}
+
+void MemoryBlock::insertFreeRange(VkDeviceSize offset, VkDeviceSize rangeSize)
+{
+    freeByOffset.emplace(offset, rangeSize);
+    freeBySize.emplace(rangeSize, offset);
+}
+
+void MemoryBlock::eraseFreeRange(std::map<VkDeviceSize, VkDeviceSize>::iterator it)
+{
+    auto [first, last] = freeBySize.equal_range(it->second);
+    for (; first != last; ++first) {
+        if (first->second == it->first) {
+            freeBySize.erase(first);
+            break;
+        }
+    }
+    freeByOffset.erase(it);
+}
+
+void MemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice vkDevice, VkDeviceSize preferredBlockSize)
+{
+    device = vkDevice;
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    bufferImageGranularity = std::max<VkDeviceSize>(props.limits.bufferImageGranularity, 1);
+    maxAllocationCount = props.limits.maxMemoryAllocationCount;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+    pools.resize(memoryProperties.memoryTypeCount);
+    blockSizes.resize(memoryProperties.memoryTypeCount);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        // Small heaps (e.g. the 256 MiB BAR window) get proportionally
+        // smaller blocks so one block cannot exhaust them.
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+        VkDeviceSize blockSize = preferredBlockSize;
+        if (heapSize < 1024ull * 1024 * 1024)
+            blockSize = std::min(blockSize, alignUp(heapSize / 8, bufferImageGranularity));
+        blockSizes[i] = blockSize;
+    }
+}
+
+void MemoryAllocator::destroy()
+{
+    std::lock_guard lock(mutex);
+    for (auto& pool : pools) {
+        for (auto& block : pool.blocks)
+            releaseBlock(std::move(block));
+        pool.blocks.clear();
+    }
+    liveAllocationCount = 0;
+}
+
+void MemoryAllocator::adjustForGranularity(AllocationKind kind, VkDeviceSize& size, VkDeviceSize& alignment) const
+{
+    // Giving optimal-tiling images whole granularity pages means neither
+    // neighbour can be a linear resource on the same page, whichever order
+    // they were placed in.
+    if (kind == AllocationKind::Optimal && bufferImageGranularity > 1) {
+        alignment = std::max(alignment, bufferImageGranularity);
+        size = alignUp(size, bufferImageGranularity);
+    }
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, AllocationKind kind)
+{
+    VkDeviceSize size = requirements.size;
+    VkDeviceSize alignment = requirements.alignment;
+    adjustForGranularity(kind, size, alignment);
+
+    std::lock_guard lock(mutex);
+    auto& pool = pools[memoryTypeIndex];
+    Allocation allocation;
+    VkDeviceSize blockSize = blockSizes[memoryTypeIndex];
+    if (size <= blockSize / 2) {
+        for (auto& block : pool.blocks) {
+            if (block->capacity() == blockSize && block->allocate(size, alignment, allocation)) {
+                liveAllocationCount++;
+                return allocation;
+            }
+        }
+    } else {
+        // Large resources get a block of their own, released as soon as the
+        // resource is freed.
+        blockSize = alignUp(size, bufferImageGranularity);
+    }
+
+    auto block = allocateBlock(blockSize, memoryTypeIndex);
+    if (!block->allocate(size, alignment, allocation)) {
+        throw std::runtime_error("failed to sub-allocate from a fresh memory block!");
+    }
+    pool.blocks.push_back(std::move(block));
+    liveAllocationCount++;
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation)
+{
+    if (!allocation.block)
+        return;
+    std::lock_guard lock(mutex);
+    MemoryBlock* block = allocation.block;
+    block->free(allocation);
+    liveAllocationCount--;
+    allocation = {};
+
+    // Keep one empty standard block per memory type around so alloc/free
+    // churn at the edge of a block does not hit vkAllocateMemory every time.
+    if (!block->empty())
+        return;
+    auto& blocks = pools[block->memoryType()].blocks;
+    bool dedicated = block->capacity() != blockSizes[block->memoryType()];
+    auto emptyBlocks = std::count_if(blocks.begin(), blocks.end(), [](const auto& b) { return b->empty(); });
+    if (dedicated || emptyBlocks > 1) {
+        auto it = std::find_if(blocks.begin(), blocks.end(), [block](const auto& b) { return b.get() == block; });
+        releaseBlock(std::move(*it));
+        blocks.erase(it);
+    }
+}
+
+AllocatorStats MemoryAllocator::stats() const
+{
+    std::lock_guard lock(mutex);
+    AllocatorStats result;
+    result.deviceAllocations = deviceAllocationCount;
+    result.liveAllocations = liveAllocationCount;
+    auto accumulate = [&result](const std::unique_ptr<MemoryBlock>& block) {
+        result.reservedBytes += block->capacity();
+        result.usedBytes += block->used();
+    };
+    for (const auto& pool : pools)
+        std::for_each(pool.blocks.begin(), pool.blocks.end(), accumulate);
+    return result;
+}
+
+std::unique_ptr<MemoryBlock> MemoryAllocator::allocateBlock(VkDeviceSize size, uint32_t memoryTypeIndex)
+{
+    if (deviceAllocationCount >= maxAllocationCount) {
+        throw std::runtime_error("maxMemoryAllocationCount exceeded!");
+    }
+    VkMemoryAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate memory block!");
+    }
+    deviceAllocationCount++;
+
+    void* mapped = nullptr;
+    if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map memory block!");
+        }
+    }
+    return std::make_unique<MemoryBlock>(memory, size, memoryTypeIndex, mapped);
+}
+
+void MemoryAllocator::releaseBlock(std::unique_ptr<MemoryBlock> block)
+{
+    // vkFreeMemory implicitly unmaps a persistently mapped block.
+    vkFreeMemory(device, block->handle(), nullptr);
+    deviceAllocationCount--;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// Buffers and linear-tiling images are "linear" resources in the sense of
+// bufferImageGranularity; optimal-tiling images must not share a granularity
+// page with them.
+enum class AllocationKind {
+    Linear,
+    Optimal,
+};
+
+class MemoryBlock;
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    MemoryBlock* block = nullptr;
+};
+
+// One VkDeviceMemory object, persistently mapped when host visible, with a
+// coalescing free list searched best-fit.
+class MemoryBlock {
+public:
+    MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, void* mapped);
+
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+    void free(const Allocation& allocation);
+
+    bool empty() const { return usedBytes == 0; }
+    VkDeviceSize used() const { return usedBytes; }
+    VkDeviceSize capacity() const { return size; }
+    VkDeviceMemory handle() const { return memory; }
+    uint32_t memoryType() const { return memoryTypeIndex; }
+    size_t freeRangeCount() const { return freeByOffset.size(); }
+
+private:
+    void insertFreeRange(VkDeviceSize offset, VkDeviceSize rangeSize);
+    void eraseFreeRange(std::map<VkDeviceSize, VkDeviceSize>::iterator it);
+
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t memoryTypeIndex;
+    void* mapped;
+    VkDeviceSize usedBytes = 0;
+    std::map<VkDeviceSize, VkDeviceSize> freeByOffset;
+    std::multimap<VkDeviceSize, VkDeviceSize> freeBySize;
+};
+
+struct AllocatorStats {
+    uint32_t deviceAllocations = 0;
+    uint32_t liveAllocations = 0;
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+};
+
+// Sub-allocates buffers and images out of large per-memory-type blocks so the
+// driver sees a handful of vkAllocateMemory calls instead of one per resource.
+class MemoryAllocator {
+public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+    void destroy();
+
+    Allocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, AllocationKind kind);
+    void free(Allocation& allocation);
+
+    AllocatorStats stats() const;
+
+private:
+    struct MemoryTypePool {
+        std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    };
+
+    std::unique_ptr<MemoryBlock> allocateBlock(VkDeviceSize size, uint32_t memoryTypeIndex);
+    void releaseBlock(std::unique_ptr<MemoryBlock> block);
+    void adjustForGranularity(AllocationKind kind, VkDeviceSize& size, VkDeviceSize& alignment) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties {};
+    VkDeviceSize bufferImageGranularity = 1;
+    uint32_t maxAllocationCount = 0;
+    uint32_t deviceAllocationCount = 0;
+    uint32_t liveAllocationCount = 0;
+    std::vector<VkDeviceSize> blockSizes;
+    std::vector<MemoryTypePool> pools;
+    mutable std::mutex mutex;
+};
@@ -0,0 +1,659 @@
+// mesh-converter: turns an OBJ or glTF 2.0 (.gltf/.glb) file into the binary
+// mesh format of MeshFile.hpp.
+//
+// Only positions and vertex colors are kept, which is all the renderer
+// fetches. OBJ objects, groups and material switches, and glTF primitives,
+// each become a submesh. glTF node transforms are not applied; meshes are
+// written in their own space.
+//
+// Unless --no-optimize is given, every submesh is reordered for the vertex
+// cache, overdraw and vertex fetch (MeshOptimizer.hpp) on the way through,
+// and the ACMR/ATVR before and after is printed.
+
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "MeshFile.hpp"
+#include "MeshOptimizer.hpp"
+
+namespace {
+struct MeshData {
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshSubmesh> submeshes;
+
+    void beginSubmesh()
+    {
+        if (!submeshes.empty() && submeshes.back().indexCount == 0)
+            return;
+        MeshSubmesh submesh {};
+        submesh.firstIndex = static_cast<uint32_t>(indices.size());
+        submesh.firstVertex = static_cast<uint32_t>(vertices.size());
+        submeshes.push_back(submesh);
+    }
+    void endSubmesh()
+    {
+        MeshSubmesh& submesh = submeshes.back();
+        submesh.indexCount = static_cast<uint32_t>(indices.size()) - submesh.firstIndex;
+        submesh.vertexCount = static_cast<uint32_t>(vertices.size()) - submesh.firstVertex;
+    }
+};
+
+std::string readFile(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open " + path.string() + "!");
+    }
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// OBJ
+
+std::string_view nextToken(std::string_view& line)
+{
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    size_t end = line.find_first_of(" \t\r", start);
+    std::string_view token = line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+    line = end == std::string_view::npos ? std::string_view {} : line.substr(end);
+    return token;
+}
+
+float parseFloat(std::string_view token)
+{
+    float value = 0.0f;
+    std::from_chars(token.data(), token.data() + token.size(), value);
+    return value;
+}
+
+// Resolves the position part of an OBJ face corner ("7", "7/1", "7//3",
+// "-2/...") to a zero-based index.
+uint32_t parseCorner(std::string_view token, size_t positionCount)
+{
+    long value = 0;
+    auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (error != std::errc() || value == 0) {
+        throw std::runtime_error("malformed OBJ face!");
+    }
+    long index = value > 0 ? value - 1 : static_cast<long>(positionCount) + value;
+    if (index < 0 || static_cast<size_t>(index) >= positionCount) {
+        throw std::runtime_error("OBJ face index out of range!");
+    }
+    return static_cast<uint32_t>(index);
+}
+
+MeshData loadObj(const std::filesystem::path& path)
+{
+    std::string text = readFile(path);
+    std::vector<MeshVertex> positions;
+    MeshData mesh;
+    // OBJ position index to output vertex, per submesh, so that every
+    // submesh gets a vertex range of its own.
+    std::unordered_map<uint32_t, uint32_t> remap;
+    std::vector<uint32_t> polygon;
+    mesh.beginSubmesh();
+
+    std::string_view rest(text);
+    while (!rest.empty()) {
+        size_t newline = rest.find('\n');
+        std::string_view line = rest.substr(0, newline);
+        rest = newline == std::string_view::npos ? std::string_view {} : rest.substr(newline + 1);
+
+        std::string_view keyword = nextToken(line);
+        if (keyword == "v") {
+            // Optional trailing r g b, as written by most scanners.
+            MeshVertex vertex { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+            for (float& coordinate : vertex.position)
+                coordinate = parseFloat(nextToken(line));
+            std::string_view red = nextToken(line);
+            if (!red.empty()) {
+                vertex.color[0] = parseFloat(red);
+                vertex.color[1] = parseFloat(nextToken(line));
+                vertex.color[2] = parseFloat(nextToken(line));
+            }
+            positions.push_back(vertex);
+        } else if (keyword == "f") {
+            polygon.clear();
+            for (std::string_view corner = nextToken(line); !corner.empty(); corner = nextToken(line)) {
+                uint32_t position = parseCorner(corner, positions.size());
+                auto [it, inserted] = remap.try_emplace(position, static_cast<uint32_t>(mesh.vertices.size()));
+                if (inserted)
+                    mesh.vertices.push_back(positions[position]);
+                polygon.push_back(it->second);
+            }
+            // Fan triangulation; fine for the convex polygons exporters emit.
+            for (size_t i = 2; i < polygon.size(); i++)
+                mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+        } else if (keyword == "o" || keyword == "g" || keyword == "usemtl") {
+            mesh.endSubmesh();
+            mesh.beginSubmesh();
+            remap.clear();
+        }
+    }
+    mesh.endSubmesh();
+    if (mesh.submeshes.back().indexCount == 0)
+        mesh.submeshes.pop_back();
+    return mesh;
+}
+
+// glTF
+
+// Just enough JSON for glTF. \u escapes are kept as written; nothing the
+// converter looks up contains them.
+struct Json {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    double number = 0.0;
+    std::string string;
+    std::vector<Json> array;
+    std::vector<std::pair<std::string, Json>> object;
+
+    const Json* find(std::string_view key) const
+    {
+        for (const auto& [name, value] : object) {
+            if (name == key)
+                return &value;
+        }
+        return nullptr;
+    }
+    const Json& at(std::string_view key) const
+    {
+        const Json* value = find(key);
+        if (!value) {
+            throw std::runtime_error("glTF is missing \"" + std::string(key) + "\"!");
+        }
+        return *value;
+    }
+    const Json& at(size_t index) const
+    {
+        if (type != Type::Array || index >= array.size()) {
+            throw std::runtime_error("glTF index out of range!");
+        }
+        return array[index];
+    }
+    uint64_t integer() const { return static_cast<uint64_t>(number); }
+    uint64_t integerOr(std::string_view key, uint64_t fallback) const
+    {
+        const Json* value = find(key);
+        return value ? value->integer() : fallback;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view text)
+        : text(text)
+    {
+    }
+
+    Json parse()
+    {
+        Json value = parseValue();
+        skipWhitespace();
+        if (position != text.size())
+            fail();
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail() const
+    {
+        throw std::runtime_error("malformed glTF JSON at offset " + std::to_string(position) + "!");
+    }
+    void skipWhitespace()
+    {
+        while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+            position++;
+    }
+    bool consume(char c)
+    {
+        skipWhitespace();
+        if (position < text.size() && text[position] == c) {
+            position++;
+            return true;
+        }
+        return false;
+    }
+    void expect(char c)
+    {
+        if (!consume(c))
+            fail();
+    }
+    bool consumeWord(std::string_view word)
+    {
+        if (text.substr(position, word.size()) != word)
+            return false;
+        position += word.size();
+        return true;
+    }
+
+    Json parseValue()
+    {
+        skipWhitespace();
+        if (position >= text.size())
+            fail();
+        Json value;
+        char c = text[position];
+        if (c == '{') {
+            value.type = Json::Type::Object;
+            position++;
+            if (consume('}'))
+                return value;
+            do {
+                skipWhitespace();
+                std::string key = parseString();
+                expect(':');
+                value.object.emplace_back(std::move(key), parseValue());
+            } while (consume(','));
+            expect('}');
+        } else if (c == '[') {
+            value.type = Json::Type::Array;
+            position++;
+            if (consume(']'))
+                return value;
+            do {
+                value.array.push_back(parseValue());
+            } while (consume(','));
+            expect(']');
+        } else if (c == '"') {
+            value.type = Json::Type::String;
+            value.string = parseString();
+        } else if (consumeWord("true")) {
+            value.type = Json::Type::Bool;
+            value.number = 1.0;
+        } else if (consumeWord("false")) {
+            value.type = Json::Type::Bool;
+        } else if (consumeWord("null")) {
+            value.type = Json::Type::Null;
+        } else {
+            value.type = Json::Type::Number;
+            auto [end, error] = std::from_chars(text.data() + position, text.data() + text.size(), value.number);
+            if (error != std::errc())
+                fail();
+            position = static_cast<size_t>(end - text.data());
+        }
+        return value;
+    }
+
+    std::string parseString()
+    {
+        if (position >= text.size() || text[position] != '"')
+            fail();
+        position++;
+        std::string result;
+        while (position < text.size() && text[position] != '"') {
+            char c = text[position++];
+            if (c == '\\' && position < text.size()) {
+                char escaped = text[position++];
+                switch (escaped) {
+                case 'n':
+                    result += '\n';
+                    break;
+                case 't':
+                    result += '\t';
+                    break;
+                case 'u':
+                    // Keys and URIs glTF cares about are ASCII; keep the
+                    // escape as written.
+                    result += "\\u";
+                    break;
+                default:
+                    result += escaped;
+                    break;
+                }
+            } else {
+                result += c;
+            }
+        }
+        if (position >= text.size())
+            fail();
+        position++;
+        return result;
+    }
+
+    std::string_view text;
+    size_t position = 0;
+};
+
+std::string decodeBase64(std::string_view encoded)
+{
+    auto value = [](char c) -> int {
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A';
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 26;
+        if (c >= '0' && c <= '9')
+            return c - '0' + 52;
+        if (c == '+')
+            return 62;
+        if (c == '/')
+            return 63;
+        return -1;
+    };
+    std::string decoded;
+    decoded.reserve(encoded.size() * 3 / 4);
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (char c : encoded) {
+        int v = value(c);
+        if (v < 0)
+            continue;
+        bits = (bits << 6) | static_cast<uint32_t>(v);
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            decoded += static_cast<char>((bits >> bitCount) & 0xff);
+        }
+    }
+    return decoded;
+}
+
+const uint32_t GLB_MAGIC = 0x46546c67; // "glTF"
+const uint32_t GLB_CHUNK_JSON = 0x4e4f534a;
+const uint32_t GLB_CHUNK_BIN = 0x004e4942;
+
+const uint32_t COMPONENT_UNSIGNED_BYTE = 5121;
+const uint32_t COMPONENT_UNSIGNED_SHORT = 5123;
+const uint32_t COMPONENT_UNSIGNED_INT = 5125;
+const uint32_t COMPONENT_FLOAT = 5126;
+const uint32_t MODE_TRIANGLES = 4;
+
+class GltfLoader {
+public:
+    MeshData load(const std::filesystem::path& path)
+    {
+        directory = path.parent_path();
+        std::string file = readFile(path);
+        std::string jsonText;
+        if (file.size() >= 12 && readU32(file, 0) == GLB_MAGIC) {
+            size_t offset = 12;
+            while (offset + 8 <= file.size()) {
+                uint32_t chunkLength = readU32(file, offset);
+                uint32_t chunkType = readU32(file, offset + 4);
+                if (offset + 8 + chunkLength > file.size()) {
+                    throw std::runtime_error("truncated GLB chunk!");
+                }
+                if (chunkType == GLB_CHUNK_JSON)
+                    jsonText = file.substr(offset + 8, chunkLength);
+                else if (chunkType == GLB_CHUNK_BIN)
+                    glbBuffer = file.substr(offset + 8, chunkLength);
+                offset += 8 + chunkLength;
+            }
+        } else {
+            jsonText = std::move(file);
+        }
+        root = JsonParser(jsonText).parse();
+
+        if (const Json* buffersJson = root.find("buffers")) {
+            for (const Json& buffer : buffersJson->array)
+                buffers.push_back(loadBuffer(buffer));
+        }
+
+        MeshData mesh;
+        const Json* meshes = root.find("meshes");
+        if (!meshes) {
+            throw std::runtime_error("glTF file has no meshes!");
+        }
+        for (const Json& gltfMesh : meshes->array) {
+            for (const Json& primitive : gltfMesh.at("primitives").array) {
+                if (primitive.integerOr("mode", MODE_TRIANGLES) != MODE_TRIANGLES) {
+                    std::cerr << "skipping a non-triangle primitive\n";
+                    continue;
+                }
+                appendPrimitive(primitive, mesh);
+            }
+        }
+        return mesh;
+    }
+
+private:
+    static uint32_t readU32(const std::string& data, size_t offset)
+    {
+        uint32_t value;
+        std::memcpy(&value, data.data() + offset, 4);
+        return value;
+    }
+
+    std::string loadBuffer(const Json& buffer)
+    {
+        const Json* uri = buffer.find("uri");
+        std::string data;
+        if (!uri) {
+            data = glbBuffer;
+        } else if (uri->string.rfind("data:", 0) == 0) {
+            size_t comma = uri->string.find(',');
+            data = decodeBase64(std::string_view(uri->string).substr(comma == std::string::npos ? 0 : comma + 1));
+        } else {
+            data = readFile(directory / uri->string);
+        }
+        if (data.size() < buffer.integerOr("byteLength", 0)) {
+            throw std::runtime_error("glTF buffer shorter than its byteLength!");
+        }
+        return data;
+    }
+
+    // Reads element `index`, component `component` of an accessor as float,
+    // applying the normalization of integer components.
+    struct Accessor {
+        const char* data = nullptr;
+        uint64_t count = 0;
+        uint64_t stride = 0;
+        uint32_t componentType = 0;
+        uint32_t components = 0;
+        bool normalized = false;
+
+        float read(uint64_t index, uint32_t component) const
+        {
+            const char* element = data + index * stride;
+            switch (componentType) {
+            case COMPONENT_FLOAT: {
+                float value;
+                std::memcpy(&value, element + component * 4, 4);
+                return value;
+            }
+            case COMPONENT_UNSIGNED_BYTE: {
+                auto value = static_cast<uint8_t>(element[component]);
+                return normalized ? value / 255.0f : value;
+            }
+            case COMPONENT_UNSIGNED_SHORT: {
+                uint16_t value;
+                std::memcpy(&value, element + component * 2, 2);
+                return normalized ? value / 65535.0f : value;
+            }
+            default:
+                throw std::runtime_error("unsupported glTF attribute component type!");
+            }
+        }
+        uint32_t readIndex(uint64_t index) const
+        {
+            const char* element = data + index * stride;
+            switch (componentType) {
+            case COMPONENT_UNSIGNED_BYTE:
+                return static_cast<uint8_t>(*element);
+            case COMPONENT_UNSIGNED_SHORT: {
+                uint16_t value;
+                std::memcpy(&value, element, 2);
+                return value;
+            }
+            case COMPONENT_UNSIGNED_INT: {
+                uint32_t value;
+                std::memcpy(&value, element, 4);
+                return value;
+            }
+            default:
+                throw std::runtime_error("unsupported glTF index component type!");
+            }
+        }
+    };
+
+    static uint32_t componentSize(uint32_t componentType)
+    {
+        switch (componentType) {
+        case COMPONENT_UNSIGNED_BYTE:
+            return 1;
+        case COMPONENT_UNSIGNED_SHORT:
+            return 2;
+        case COMPONENT_UNSIGNED_INT:
+        case COMPONENT_FLOAT:
+            return 4;
+        default:
+            throw std::runtime_error("unsupported glTF component type!");
+        }
+    }
+
+    static uint32_t componentCount(const std::string& type)
+    {
+        if (type == "SCALAR")
+            return 1;
+        if (type == "VEC2")
+            return 2;
+        if (type == "VEC3")
+            return 3;
+        if (type == "VEC4")
+            return 4;
+        throw std::runtime_error("unsupported glTF accessor type " + type + "!");
+    }
+
+    Accessor accessor(uint64_t index) const
+    {
+        const Json& json = root.at("accessors").at(index);
+        Accessor result;
+        result.count = json.at("count").integer();
+        result.componentType = static_cast<uint32_t>(json.at("componentType").integer());
+        result.components = componentCount(json.at("type").string);
+        const Json* normalized = json.find("normalized");
+        result.normalized = normalized && normalized->number != 0.0;
+        uint64_t elementSize = uint64_t(componentSize(result.componentType)) * result.components;
+
+        // Sparse and bufferView-less accessors (all zeros) do not occur in
+        // exported geometry.
+        const Json& view = root.at("bufferViews").at(json.at("bufferView").integer());
+        const std::string& buffer = buffers.at(view.at("buffer").integer());
+        uint64_t offset = view.integerOr("byteOffset", 0) + json.integerOr("byteOffset", 0);
+        result.stride = view.integerOr("byteStride", 0);
+        if (result.stride == 0)
+            result.stride = elementSize;
+        if (result.count > 0 && offset + (result.count - 1) * result.stride + elementSize > buffer.size()) {
+            throw std::runtime_error("glTF accessor reads past its buffer!");
+        }
+        result.data = buffer.data() + offset;
+        return result;
+    }
+
+    void appendPrimitive(const Json& primitive, MeshData& mesh) const
+    {
+        const Json& attributes = primitive.at("attributes");
+        Accessor positions = accessor(attributes.at("POSITION").integer());
+        if (positions.components != 3) {
+            throw std::runtime_error("glTF POSITION must be VEC3!");
+        }
+        const Json* colorIndex = attributes.find("COLOR_0");
+        Accessor colors;
+        if (colorIndex)
+            colors = accessor(colorIndex->integer());
+
+        mesh.beginSubmesh();
+        auto base = static_cast<uint32_t>(mesh.vertices.size());
+        for (uint64_t i = 0; i < positions.count; i++) {
+            MeshVertex vertex { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+            for (uint32_t axis = 0; axis < 3; axis++)
+                vertex.position[axis] = positions.read(i, axis);
+            if (colorIndex && i < colors.count) {
+                for (uint32_t channel = 0; channel < 3; channel++)
+                    vertex.color[channel] = colors.read(i, channel);
+            }
+            mesh.vertices.push_back(vertex);
+        }
+        if (const Json* indicesIndex = primitive.find("indices")) {
+            Accessor indices = accessor(indicesIndex->integer());
+            for (uint64_t i = 0; i < indices.count; i++) {
+                uint32_t index = indices.readIndex(i);
+                if (index >= positions.count) {
+                    throw std::runtime_error("glTF index out of range!");
+                }
+                mesh.indices.push_back(base + index);
+            }
+        } else {
+            for (uint64_t i = 0; i < positions.count; i++)
+                mesh.indices.push_back(base + static_cast<uint32_t>(i));
+        }
+        mesh.endSubmesh();
+    }
+
+    std::filesystem::path directory;
+    std::string glbBuffer;
+    std::vector<std::string> buffers;
+    Json root;
+};
+
+std::string lowercaseExtension(const std::filesystem::path& path)
+{
+    std::string extension = path.extension().string();
+    for (char& c : extension)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return extension;
+}
+}
+
+int main(int argc, char** argv)
+{
+    bool optimize = true;
+    int firstPath = 1;
+    if (argc == 4 && std::string_view(argv[1]) == "--no-optimize") {
+        optimize = false;
+        firstPath = 2;
+    }
+    if (argc - firstPath != 2) {
+        std::cerr << "usage: " << argv[0] << " [--no-optimize] <input.obj|input.gltf|input.glb> <output.vmesh>\n";
+        return EXIT_FAILURE;
+    }
+    const char* output = argv[firstPath + 1];
+    try {
+        std::filesystem::path input = argv[firstPath];
+        auto start = std::chrono::steady_clock::now();
+        std::string extension = lowercaseExtension(input);
+        MeshData mesh;
+        if (extension == ".obj")
+            mesh = loadObj(input);
+        else if (extension == ".gltf" || extension == ".glb")
+            mesh = GltfLoader().load(input);
+        else
+            throw std::runtime_error("unsupported input format " + extension + "!");
+        if (mesh.indices.empty()) {
+            throw std::runtime_error("input contains no triangles!");
+        }
+        if (optimize) {
+            VertexCacheStats before = analyzeVertexCache(mesh.indices);
+            optimizeMesh(mesh.vertices, mesh.indices, mesh.submeshes);
+            VertexCacheStats after = analyzeVertexCache(mesh.indices);
+            std::cout << "vertex cache (" << DEFAULT_VERTEX_CACHE_SIZE << " entry FIFO): ACMR " << before.acmr << " -> " << after.acmr
+                      << ", ATVR " << before.atvr << " -> " << after.atvr << '\n';
+        }
+        writeMeshFile(output, mesh.vertices, mesh.indices, mesh.submeshes);
+        auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << output << ": " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles, "
+                  << mesh.submeshes.size() << " submeshes (" << time << " ms)\n";
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+#include "MeshFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+void growBounds(float (&boundsMin)[3], float (&boundsMax)[3], const float (&point)[3])
+{
+    for (int axis = 0; axis < 3; axis++) {
+        boundsMin[axis] = std::min(boundsMin[axis], point[axis]);
+        boundsMax[axis] = std::max(boundsMax[axis], point[axis]);
+    }
+}
+
+void resetBounds(float (&boundsMin)[3], float (&boundsMax)[3])
+{
+    std::fill(boundsMin, boundsMin + 3, std::numeric_limits<float>::max());
+    std::fill(boundsMax, boundsMax + 3, std::numeric_limits<float>::lowest());
+}
+
+bool validHeader(const MeshHeader& header, uint64_t fileSize)
+{
+    if (header.magic != MESH_MAGIC || header.version != MESH_VERSION || header.fileSize != fileSize)
+        return false;
+    if (header.vertexStride != sizeof(MeshVertex) || (header.indexSize != 2 && header.indexSize != 4))
+        return false;
+    // An empty mesh would need zero-sized buffers, which Vulkan forbids.
+    if (header.vertexCount == 0 || header.indexCount == 0)
+        return false;
+    for (uint64_t offset : { header.vertexOffset, header.indexOffset, header.submeshOffset }) {
+        if (offset % MESH_SECTION_ALIGNMENT != 0 || offset < sizeof(MeshHeader))
+            return false;
+    }
+    // Compared against what is left after the offset, so an offset near
+    // 2^64 cannot wrap the section's end back inside the file. The sizes
+    // themselves are 32-bit counts times small strides and cannot overflow.
+    auto inFile = [fileSize](uint64_t offset, uint64_t size) { return offset <= fileSize && size <= fileSize - offset; };
+    return inFile(header.vertexOffset, uint64_t(header.vertexCount) * header.vertexStride)
+        && inFile(header.indexOffset, uint64_t(header.indexCount) * header.indexSize)
+        && inFile(header.submeshOffset, uint64_t(header.submeshCount) * sizeof(MeshSubmesh));
+}
+
+template <typename Index>
+uint32_t maxIndex(const void* indices, uint32_t count)
+{
+    const auto* values = static_cast<const Index*>(indices);
+    Index largest = 0;
+    for (uint32_t i = 0; i < count; i++)
+        largest = std::max(largest, values[i]);
+    return largest;
+}
+}
+
+void writeMeshFile(const std::string& path, const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices, std::vector<MeshSubmesh> submeshes)
+{
+    MeshHeader header {};
+    header.magic = MESH_MAGIC;
+    header.version = MESH_VERSION;
+    header.vertexStride = sizeof(MeshVertex);
+    header.indexSize = vertices.size() <= 0x10000 ? 2 : 4;
+    header.vertexCount = static_cast<uint32_t>(vertices.size());
+    header.indexCount = static_cast<uint32_t>(indices.size());
+    header.submeshCount = static_cast<uint32_t>(submeshes.size());
+    header.vertexOffset = alignMeshSection(sizeof(MeshHeader));
+    header.indexOffset = alignMeshSection(header.vertexOffset + uint64_t(header.vertexCount) * header.vertexStride);
+    header.submeshOffset = alignMeshSection(header.indexOffset + uint64_t(header.indexCount) * header.indexSize);
+    header.fileSize = header.submeshOffset + uint64_t(header.submeshCount) * sizeof(MeshSubmesh);
+
+    resetBounds(header.boundsMin, header.boundsMax);
+    for (auto& submesh : submeshes) {
+        if (uint64_t(submesh.firstVertex) + submesh.vertexCount > vertices.size()
+            || uint64_t(submesh.firstIndex) + submesh.indexCount > indices.size()) {
+            throw std::runtime_error("submesh range outside the mesh!");
+        }
+        resetBounds(submesh.boundsMin, submesh.boundsMax);
+        for (uint32_t i = 0; i < submesh.vertexCount; i++)
+            growBounds(submesh.boundsMin, submesh.boundsMax, vertices[submesh.firstVertex + i].position);
+        growBounds(header.boundsMin, header.boundsMax, submesh.boundsMin);
+        growBounds(header.boundsMin, header.boundsMax, submesh.boundsMax);
+    }
+
+    // Assembled in memory so the file goes out in a single write.
+    std::vector<char> file(header.fileSize, 0);
+    std::memcpy(file.data(), &header, sizeof(header));
+    std::memcpy(file.data() + header.vertexOffset, vertices.data(), vertices.size() * sizeof(MeshVertex));
+    char* indexOut = file.data() + header.indexOffset;
+    if (header.indexSize == 2) {
+        for (size_t i = 0; i < indices.size(); i++) {
+            auto index = static_cast<uint16_t>(indices[i]);
+            std::memcpy(indexOut + i * 2, &index, 2);
+        }
+    } else {
+        std::memcpy(indexOut, indices.data(), indices.size() * 4);
+    }
+    std::memcpy(file.data() + header.submeshOffset, submeshes.data(), submeshes.size() * sizeof(MeshSubmesh));
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("failed to open mesh file for writing!");
+    }
+    out.write(file.data(), static_cast<std::streamsize>(file.size()));
+    if (!out) {
+        throw std::runtime_error("failed to write mesh file!");
+    }
+}
+
+void MappedMesh::open(const std::string& path)
+{
+    close();
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open mesh file!");
+    }
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data = contents.data();
+    length = contents.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open mesh file!");
+    }
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(MeshHeader))) {
+        ::close(fd);
+        throw std::runtime_error("mesh file is too small!");
+    }
+    length = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        length = 0;
+        throw std::runtime_error("failed to map mesh file!");
+    }
+    // Read sequentially, by the index check and then the staging copy.
+    madvise(mapping, length, MADV_SEQUENTIAL);
+    madvise(mapping, length, MADV_WILLNEED);
+    data = static_cast<const uint8_t*>(mapping);
+#endif
+    if (length < sizeof(MeshHeader) || !validHeader(header(), length)) {
+        close();
+        throw std::runtime_error("invalid mesh file!");
+    }
+    for (uint32_t i = 0; i < header().submeshCount; i++) {
+        const MeshSubmesh& submesh = submeshes()[i];
+        if (uint64_t(submesh.firstVertex) + submesh.vertexCount > header().vertexCount
+            || uint64_t(submesh.firstIndex) + submesh.indexCount > header().indexCount) {
+            close();
+            throw std::runtime_error("invalid mesh file!");
+        }
+    }
+    // An index past the vertices would make the GPU fetch out of bounds.
+    uint32_t largest = header().indexSize == 2 ? maxIndex<uint16_t>(indexData(), header().indexCount)
+                                               : maxIndex<uint32_t>(indexData(), header().indexCount);
+    if (largest >= header().vertexCount) {
+        close();
+        throw std::runtime_error("mesh index out of range!");
+    }
+}
+
+void MappedMesh::close()
+{
+    if (!data)
+        return;
+#ifdef _WIN32
+    contents.clear();
+    contents.shrink_to_fit();
+#else
+    munmap(const_cast<uint8_t*>(data), length);
+#endif
+    data = nullptr;
+    length = 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary mesh container written by mesh-converter and mapped straight into
+// memory by MappedMesh. Little-endian; every section starts on a
+// MESH_SECTION_ALIGNMENT boundary:
+//
+//   MeshHeader | vertices | indices | MeshSubmesh[submeshCount]
+//
+// Vertices are stored in the layout the vertex shaders fetch, so loading is
+// a header check followed by a copy into the staging buffer.
+const uint32_t MESH_MAGIC = 0x48534d56; // "VMSH"
+const uint32_t MESH_VERSION = 1;
+const uint64_t MESH_SECTION_ALIGNMENT = 16;
+
+struct MeshVertex {
+    float position[3];
+    float color[3];
+};
+
+struct MeshHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride;
+    // 2 or 4 bytes; 16-bit whenever every vertex is addressable with it.
+    uint32_t indexSize;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t submeshCount;
+    uint32_t reserved;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t submeshOffset;
+    uint64_t fileSize;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// Indices are absolute, so the whole mesh can also be drawn in one call.
+// Each submesh owns a contiguous vertex range.
+struct MeshSubmesh {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+static_assert(sizeof(MeshVertex) == 24);
+static_assert(sizeof(MeshHeader) == 88);
+static_assert(sizeof(MeshSubmesh) == 40);
+
+inline uint64_t alignMeshSection(uint64_t offset)
+{
+    return (offset + MESH_SECTION_ALIGNMENT - 1) / MESH_SECTION_ALIGNMENT * MESH_SECTION_ALIGNMENT;
+}
+
+// Lays out and writes a mesh file; indices are narrowed to 16 bits when the
+// vertex count allows it. Bounds are computed here.
+void writeMeshFile(const std::string& path, const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices, std::vector<MeshSubmesh> submeshes);
+
+// A read-only mapping of a mesh file. Nothing is parsed or copied: the
+// section accessors point into the mapping, which stays valid until close().
+class MappedMesh {
+public:
+    MappedMesh() = default;
+    ~MappedMesh() { close(); }
+    MappedMesh(const MappedMesh&) = delete;
+    MappedMesh& operator=(const MappedMesh&) = delete;
+
+    // Throws if the file cannot be mapped or its header does not describe it.
+    void open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    const MeshHeader& header() const { return *reinterpret_cast<const MeshHeader*>(data); }
+    const void* vertexData() const { return data + header().vertexOffset; }
+    uint64_t vertexDataSize() const { return uint64_t(header().vertexCount) * header().vertexStride; }
+    const void* indexData() const { return data + header().indexOffset; }
+    uint64_t indexDataSize() const { return uint64_t(header().indexCount) * header().indexSize; }
+    const MeshSubmesh* submeshes() const { return reinterpret_cast<const MeshSubmesh*>(data + header().submeshOffset); }
+    uint64_t fileSize() const { return length; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::vector<uint8_t> contents;
+#endif
+};
@@ -0,0 +1,243 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace {
+const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+// Triangles in Tipsify order, as triangle indices, and the offsets at which
+// it ran into a dead end and had to pick a fan outside the current one's
+// neighbourhood. Every such offset starts a new cluster.
+struct TriangleOrder {
+    std::vector<uint32_t> triangles;
+    std::vector<size_t> clusterStarts;
+};
+
+TriangleOrder tipsify(const uint32_t* indices, size_t triangleCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+    // Vertex to triangle adjacency in CSR form.
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacencyOffsets[indices[i] + 1]++;
+    std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<uint32_t> liveTriangles(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+
+    TriangleOrder order;
+    order.triangles.reserve(triangleCount);
+    uint32_t time = cacheSize + 1;
+    uint32_t cursor = 0;
+    uint32_t fan = triangleCount > 0 ? indices[0] : NONE;
+    order.clusterStarts.push_back(0);
+
+    while (fan != NONE) {
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++) {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            order.triangles.push_back(triangle);
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                uint32_t v = indices[triangle * 3 + corner];
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        // Next fan: the candidate that will still be in the cache after its
+        // remaining triangles are emitted, preferring the oldest one.
+        uint32_t next = NONE;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (liveTriangles[v] == 0)
+                continue;
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+        if (next != NONE) {
+            fan = next;
+            continue;
+        }
+
+        // Dead end: back up through recently used vertices, then scan.
+        fan = NONE;
+        while (!deadEnds.empty() && fan == NONE) {
+            uint32_t v = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[v] > 0)
+                fan = v;
+        }
+        if (fan == NONE) {
+            while (cursor < vertexCount && liveTriangles[cursor] == 0)
+                cursor++;
+            if (cursor < vertexCount)
+                fan = cursor;
+        }
+        if (fan != NONE && order.clusterStarts.back() != order.triangles.size())
+            order.clusterStarts.push_back(order.triangles.size());
+    }
+    return order;
+}
+
+// Sorts the clusters of `order` so that outward-facing ones, seen from the
+// centroid of the submesh, are drawn first.
+void sortClustersForOverdraw(TriangleOrder& order, const uint32_t* indices, const MeshVertex* vertices)
+{
+    size_t clusterCount = order.clusterStarts.size();
+    if (clusterCount < 2)
+        return;
+
+    auto position = [&](uint32_t v) {
+        const float* p = vertices[v].position;
+        return std::array<double, 3> { p[0], p[1], p[2] };
+    };
+    std::array<double, 3> meshCentroid {};
+    for (uint32_t triangle : order.triangles) {
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            auto p = position(indices[triangle * 3 + corner]);
+            for (int axis = 0; axis < 3; axis++)
+                meshCentroid[axis] += p[axis];
+        }
+    }
+    for (double& coordinate : meshCentroid)
+        coordinate /= static_cast<double>(order.triangles.size() * 3);
+
+    struct Cluster {
+        size_t begin;
+        size_t end;
+        double score;
+    };
+    std::vector<Cluster> clusters(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        Cluster& cluster = clusters[c];
+        cluster.begin = order.clusterStarts[c];
+        cluster.end = c + 1 < clusterCount ? order.clusterStarts[c + 1] : order.triangles.size();
+        // Area-weighted normal and centroid of the cluster.
+        std::array<double, 3> normal {};
+        std::array<double, 3> centroid {};
+        double area = 0.0;
+        for (size_t t = cluster.begin; t < cluster.end; t++) {
+            uint32_t triangle = order.triangles[t];
+            auto a = position(indices[triangle * 3]);
+            auto b = position(indices[triangle * 3 + 1]);
+            auto c3 = position(indices[triangle * 3 + 2]);
+            std::array<double, 3> ab { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            std::array<double, 3> ac { c3[0] - a[0], c3[1] - a[1], c3[2] - a[2] };
+            std::array<double, 3> cross { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+            double triangleArea = 0.5 * std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+            for (int axis = 0; axis < 3; axis++) {
+                normal[axis] += cross[axis];
+                centroid[axis] += (a[axis] + b[axis] + c3[axis]) / 3.0 * triangleArea;
+            }
+            area += triangleArea;
+        }
+        double normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        cluster.score = 0.0;
+        if (area > 0.0 && normalLength > 0.0) {
+            for (int axis = 0; axis < 3; axis++)
+                cluster.score += (centroid[axis] / area - meshCentroid[axis]) * normal[axis] / normalLength;
+        }
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.score > b.score; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(order.triangles.size());
+    for (const Cluster& cluster : clusters)
+        sorted.insert(sorted.end(), order.triangles.begin() + cluster.begin, order.triangles.begin() + cluster.end);
+    order.triangles = std::move(sorted);
+}
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t cacheSize)
+{
+    VertexCacheStats stats;
+    if (indices.empty())
+        return stats;
+    uint32_t maxIndex = *std::max_element(indices.begin(), indices.end());
+    std::vector<bool> referenced(maxIndex + 1, false);
+    std::vector<uint32_t> insertedAt(maxIndex + 1, NONE);
+    uint64_t misses = 0;
+    for (uint32_t v : indices) {
+        referenced[v] = true;
+        // A FIFO keeps an entry for cacheSize insertions, whatever the hits.
+        if (insertedAt[v] == NONE || misses - insertedAt[v] >= cacheSize) {
+            insertedAt[v] = static_cast<uint32_t>(misses);
+            misses++;
+        }
+    }
+    auto referencedCount = static_cast<double>(std::count(referenced.begin(), referenced.end(), true));
+    stats.acmr = static_cast<double>(misses) / static_cast<double>(indices.size() / 3);
+    stats.atvr = static_cast<double>(misses) / referencedCount;
+    return stats;
+}
+
+void optimizeMesh(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, const std::vector<MeshSubmesh>& submeshes, uint32_t cacheSize)
+{
+    std::vector<uint32_t> local;
+    std::vector<uint32_t> remap;
+    std::vector<MeshVertex> reordered;
+    for (const MeshSubmesh& submesh : submeshes) {
+        size_t triangleCount = submesh.indexCount / 3;
+        if (triangleCount == 0 || submesh.indexCount % 3 != 0)
+            continue;
+        uint32_t* submeshIndices = indices.data() + submesh.firstIndex;
+        MeshVertex* submeshVertices = vertices.data() + submesh.firstVertex;
+
+        local.resize(triangleCount * 3);
+        for (size_t i = 0; i < local.size(); i++)
+            local[i] = submeshIndices[i] - submesh.firstVertex;
+
+        TriangleOrder order = tipsify(local.data(), triangleCount, submesh.vertexCount, cacheSize);
+        sortClustersForOverdraw(order, local.data(), submeshVertices);
+
+        // Renumber in order of first use; vertices no triangle references
+        // keep their relative order at the end of the range.
+        remap.assign(submesh.vertexCount, NONE);
+        reordered.clear();
+        for (uint32_t triangle : order.triangles) {
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                uint32_t v = local[triangle * 3 + corner];
+                if (remap[v] == NONE) {
+                    remap[v] = static_cast<uint32_t>(reordered.size());
+                    reordered.push_back(submeshVertices[v]);
+                }
+            }
+        }
+        for (uint32_t v = 0; v < submesh.vertexCount; v++) {
+            if (remap[v] == NONE) {
+                remap[v] = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(submeshVertices[v]);
+            }
+        }
+        std::copy(reordered.begin(), reordered.end(), submeshVertices);
+
+        uint32_t* out = submeshIndices;
+        for (uint32_t triangle : order.triangles) {
+            for (uint32_t corner = 0; corner < 3; corner++)
+                *out++ = submesh.firstVertex + remap[local[triangle * 3 + corner]];
+        }
+    }
+}
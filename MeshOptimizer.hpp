@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshFile.hpp"
+
+// Post-transform vertex cache efficiency of an index sequence, measured
+// against a FIFO cache: ACMR is transformed vertices per triangle (0.5 is
+// the ideal for large regular meshes, 3 the worst), ATVR transformed
+// vertices per referenced vertex (1 is ideal).
+struct VertexCacheStats {
+    double acmr = 0.0;
+    double atvr = 0.0;
+};
+
+const uint32_t DEFAULT_VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
+
+// Reorders every submesh in place, without changing what is drawn:
+//   1. Tipsify (Sander et al. 2007) orders the triangles for the vertex
+//      cache and notes where it had to jump to a new region;
+//   2. the clusters between those jumps are sorted so that the ones facing
+//      away from the mesh centre, which tend to occlude the rest, come first;
+//   3. vertices are renumbered in the order the indices first touch them,
+//      so vertex fetch walks memory linearly.
+// Submesh index and vertex ranges are kept; bounds are unaffected.
+void optimizeMesh(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, const std::vector<MeshSubmesh>& submeshes,
+    uint32_t cacheSize = DEFAULT_VERTEX_CACHE_SIZE);
@@ -0,0 +1,451 @@
+#include "ParticleSystem.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ShaderModule.hpp"
+
+namespace {
+const uint32_t WORKGROUP_SIZE = 256;
+
+struct Particle {
+    glm::vec4 position;
+    glm::vec4 velocity;
+};
+
+struct SimParams {
+    float deltaTime;
+    uint32_t count;
+    uint32_t reset;
+};
+
+VkBuffer createDeviceBuffer(VkDevice device, MemoryAllocator& allocator, uint32_t memoryType, VkDeviceSize size, VkBufferUsageFlags usage, Allocation& memory)
+{
+    // Exclusive on purpose: the render buffers change hands through explicit
+    // ownership transfers, the state buffer never leaves the compute queue.
+    VkBufferCreateInfo bufferInfo {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle buffer!");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    if (!(memRequirements.memoryTypeBits & (1u << memoryType))) {
+        throw std::runtime_error("memory type not usable for particle buffer!");
+    }
+    memory = allocator.allocate(memRequirements, memoryType, AllocationKind::Linear);
+    vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+    return buffer;
+}
+}
+
+void ParticleSystem::init(const ParticleSystemInfo& info)
+{
+    device = info.device;
+    allocator = info.allocator;
+    memoryType = info.deviceLocalMemoryType;
+    computeFamily = info.computeFamily;
+    graphicsFamily = info.graphicsFamily;
+    computeQueue = info.computeQueue;
+    graphicsTimeline = info.graphicsTimeline;
+    pipelineCache = info.pipelineCache;
+    count = info.particleCount;
+
+    createBuffers();
+    createComputePipeline();
+    createRenderPipeline(info.renderPass, info.colorFormat, info.depthFormat, info.cameraSetLayout);
+
+    VkCommandPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = computeFamily;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle command pool!");
+    }
+    VkCommandBufferAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = SLOTS;
+    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate particle command buffers!");
+    }
+
+    computeTimeline.init(device);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(info.physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(info.physicalDevice, &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = queueFamilies[computeFamily].timestampValidBits;
+    if (info.timestampPeriod > 0.0f && validBits > 0) {
+        timestampPeriod = info.timestampPeriod;
+        timestampMask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+        VkQueryPoolCreateInfo queryInfo {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2 * SLOTS;
+        if (vkCreateQueryPool(device, &queryInfo, nullptr, &queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create particle query pool!");
+        }
+    }
+}
+
+void ParticleSystem::destroy()
+{
+    if (!enabled())
+        return;
+    computeTimeline.wait(computeTimeline.submitted());
+    computeTimeline.destroy();
+    for (uint32_t i = 0; i < SLOTS; i++) {
+        vkDestroyBuffer(device, renderBuffers[i], nullptr);
+        allocator->free(renderMemory[i]);
+    }
+    if (queryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device, queryPool, nullptr);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyPipeline(device, renderPipeline, nullptr);
+    vkDestroyPipelineLayout(device, renderLayout, nullptr);
+    vkDestroyPipeline(device, computePipeline, nullptr);
+    vkDestroyPipelineLayout(device, computeLayout, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroyBuffer(device, stateBuffer, nullptr);
+    allocator->free(stateMemory);
+    count = 0;
+}
+
+void ParticleSystem::createBuffers()
+{
+    stateBuffer = createDeviceBuffer(device, *allocator, memoryType, sizeof(Particle) * count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, stateMemory);
+    for (uint32_t i = 0; i < SLOTS; i++) {
+        renderBuffers[i] = createDeviceBuffer(device, *allocator, memoryType, sizeof(glm::vec4) * count,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, renderMemory[i]);
+    }
+}
+
+void ParticleSystem::createComputePipeline()
+{
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings {};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 2 * SLOTS;
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = SLOTS;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle descriptor pool!");
+    }
+    std::array<VkDescriptorSetLayout, SLOTS> layouts;
+    layouts.fill(descriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = SLOTS;
+    allocInfo.pSetLayouts = layouts.data();
+    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate particle descriptor sets!");
+    }
+    for (uint32_t i = 0; i < SLOTS; i++) {
+        VkDescriptorBufferInfo bufferInfos[] = {
+            { stateBuffer, 0, VK_WHOLE_SIZE },
+            { renderBuffers[i], 0, VK_WHOLE_SIZE },
+        };
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites {};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = descriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.size = sizeof(SimParams);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &computeLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle pipeline layout!");
+    }
+
+    VkShaderModule shaderModule = loadShaderModule(device, "shaders/particles_comp.spv");
+    VkComputePipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = computeLayout;
+    if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle compute pipeline!");
+    }
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+void ParticleSystem::createRenderPipeline(VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat, VkDescriptorSetLayout cameraSetLayout)
+{
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cameraSetLayout;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &renderLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle render pipeline layout!");
+    }
+
+    VkShaderModule vertShaderModule = loadShaderModule(device, "shaders/particle_vert.spv");
+    VkShaderModule fragShaderModule = loadShaderModule(device, "shaders/frag.spv");
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    VkVertexInputBindingDescription bindingDescription {};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(glm::vec4);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    VkVertexInputAttributeDescription attributeDescription {};
+    attributeDescription.binding = 0;
+    attributeDescription.location = 0;
+    attributeDescription.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescription.offset = 0;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = 1;
+    vertexInputInfo.pVertexAttributeDescriptions = &attributeDescription;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+    VkPipelineViewportStateCreateInfo viewportState {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_FALSE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+    VkPipelineColorBlendStateCreateInfo colorBlending {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = renderLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+    VkPipelineRenderingCreateInfo renderingInfo {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+    if (renderPass == VK_NULL_HANDLE)
+        pipelineInfo.pNext = &renderingInfo;
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &renderPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle render pipeline!");
+    }
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+}
+
+void ParticleSystem::simulate(uint64_t step, float deltaTime)
+{
+    uint32_t slot = step % SLOTS;
+    // The slot's command buffer and queries were last used by step - SLOTS.
+    if (step >= SLOTS)
+        computeTimeline.wait(readyValue(step - SLOTS));
+    if (queryPool != VK_NULL_HANDLE && submitted[slot]) {
+        uint64_t timestamps[2] = {};
+        if (vkGetQueryPoolResults(device, queryPool, slot * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            uint64_t ticks = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+            computeTime = static_cast<double>(ticks) * timestampPeriod / 1e6;
+            computeTimeValid = true;
+        }
+    }
+
+    VkCommandBuffer commandBuffer = commandBuffers[slot];
+    vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording particle command buffer!");
+    }
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, slot * 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, slot * 2);
+    }
+
+    // The previous step may still be integrating the state this one reads and
+    // overwrites; submissions to one queue are not ordered by themselves.
+    if (step > 0) {
+        VkBufferMemoryBarrier stateBarrier {};
+        stateBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        stateBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        stateBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        stateBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        stateBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        stateBarrier.buffer = stateBuffer;
+        stateBarrier.offset = 0;
+        stateBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+            &stateBarrier, 0, nullptr);
+    }
+
+    // The render buffer comes back from graphics from its second use on.
+    bool reused = step >= SLOTS;
+    if (reused) {
+        ownershipBarrier(commandBuffer, renderBuffers[slot], graphicsFamily, computeFamily,
+            0, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    SimParams params {};
+    params.deltaTime = deltaTime;
+    params.count = count;
+    params.reset = step == 0 ? 1 : 0;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout, 0, 1, &descriptorSets[slot], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    vkCmdDispatch(commandBuffer, (count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+    ownershipBarrier(commandBuffer, renderBuffers[slot], computeFamily, graphicsFamily,
+        VK_ACCESS_SHADER_WRITE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    if (queryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, slot * 2 + 1);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record particle command buffer!");
+    }
+
+    // Steps arrive in order, so the timeline's next value is readyValue(step).
+    SubmitSemaphores semaphores;
+    if (reused)
+        semaphores.wait(graphicsTimeline, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, releasedValues[slot]);
+    semaphores.signal(computeTimeline.semaphore(), computeTimeline.advance());
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    VkTimelineSemaphoreSubmitInfo timelineInfo {};
+    semaphores.apply(submitInfo, timelineInfo);
+    if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit particle simulation!");
+    }
+    submitted[slot] = true;
+}
+
+void ParticleSystem::acquireForGraphics(VkCommandBuffer commandBuffer, uint64_t step) const
+{
+    ownershipBarrier(commandBuffer, renderBuffers[step % SLOTS], computeFamily, graphicsFamily,
+        0, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, GRAPHICS_WAIT_STAGE, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
+
+void ParticleSystem::releaseFromGraphics(VkCommandBuffer commandBuffer, uint64_t step) const
+{
+    ownershipBarrier(commandBuffer, renderBuffers[step % SLOTS], graphicsFamily, computeFamily,
+        0, 0, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+void ParticleSystem::draw(VkCommandBuffer commandBuffer, uint64_t step, VkDescriptorSet cameraSet, uint32_t cameraOffset) const
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderLayout, 0, 1, &cameraSet, 1, &cameraOffset);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &renderBuffers[step % SLOTS], &offset);
+    vkCmdDraw(commandBuffer, count, 1, 0, 0);
+}
+
+bool ParticleSystem::takeComputeTime(double& milliseconds)
+{
+    if (!computeTimeValid)
+        return false;
+    milliseconds = computeTime;
+    computeTimeValid = false;
+    return true;
+}
+
+void ParticleSystem::ownershipBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+    VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) const
+{
+    // Within one family the semaphores already order and publish everything.
+    if (!asyncCompute())
+        return;
+    VkBufferMemoryBarrier barrier {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = srcFamily;
+    barrier.dstQueueFamilyIndex = dstFamily;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
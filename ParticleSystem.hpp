@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan_core.h>
+
+#include "MemoryAllocator.hpp"
+#include "Timeline.hpp"
+
+struct ParticleSystemInfo {
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    uint32_t deviceLocalMemoryType = 0;
+    uint32_t computeFamily = 0;
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    uint32_t graphicsFamily = 0;
+    // Signaled by the graphics submissions that draw the particles, with the
+    // values passed to consumed().
+    VkSemaphore graphicsTimeline = VK_NULL_HANDLE;
+    uint32_t particleCount = 0;
+    // The pipeline targets renderPass, or with dynamic rendering (a null
+    // renderPass) a single color attachment of colorFormat and a depth one of
+    // depthFormat. Particles test against the reverse-Z depth but do not
+    // write it.
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    // Of the set draw() binds: the camera as a dynamic uniform buffer at
+    // binding 0, laid out like shaders/particle.vert's UniformBufferObject.
+    VkDescriptorSetLayout cameraSetLayout = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    // Zero disables the GPU timing of the simulation.
+    float timestampPeriod = 0.0f;
+};
+
+// A particle simulation stepped by a compute shader, preferably on a queue
+// of its own so that step N + 1 integrates while graphics draws step N.
+//
+// The compute queue keeps the particle state to itself; every step also
+// writes the positions to one of two render buffers, which graphics draws
+// from. A render buffer is handed from compute to graphics and back through
+// queue family ownership transfers (when the families differ), with a
+// timeline for each direction:
+//
+//   compute step s:  wait graphics >= consumed(s - 2), acquire, integrate,
+//                    release, signal compute = readyValue(s)
+//   graphics frame:  wait compute >= readyValue(s), acquireForGraphics, draw,
+//                    releaseFromGraphics, signal graphics = consumed(s)
+class ParticleSystem {
+public:
+    void init(const ParticleSystemInfo& info);
+    void destroy();
+    bool enabled() const { return count > 0; }
+    bool asyncCompute() const { return computeFamily != graphicsFamily; }
+
+    // Records and submits simulation step `step`. Step 0 seeds the particles;
+    // steps must be submitted in order, each graphics frame consuming its
+    // step before step + 2 is submitted.
+    void simulate(uint64_t step, float deltaTime);
+
+    // The graphics submission that draws `step` waits for timeline() to
+    // reach readyValue(step), and tells consumed() which graphics timeline
+    // value it signals.
+    VkSemaphore timeline() const { return computeTimeline.semaphore(); }
+    static uint64_t readyValue(uint64_t step) { return step + 1; }
+    void consumed(uint64_t step, uint64_t graphicsValue) { releasedValues[step % SLOTS] = graphicsValue; }
+    static constexpr VkPipelineStageFlags GRAPHICS_WAIT_STAGE = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+    // Outside a render pass, before and after the draw respectively.
+    void acquireForGraphics(VkCommandBuffer commandBuffer, uint64_t step) const;
+    void releaseFromGraphics(VkCommandBuffer commandBuffer, uint64_t step) const;
+    // The camera is read from cameraSet at cameraOffset when the GPU draws,
+    // so late latching reaches the particles as well.
+    void draw(VkCommandBuffer commandBuffer, uint64_t step, VkDescriptorSet cameraSet, uint32_t cameraOffset) const;
+
+    // GPU time of the most recently completed step, once per step.
+    bool takeComputeTime(double& milliseconds);
+
+private:
+    static constexpr uint32_t SLOTS = 2;
+
+    void createBuffers();
+    void createComputePipeline();
+    void createRenderPipeline(VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat, VkDescriptorSetLayout cameraSetLayout);
+    void ownershipBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcFamily, uint32_t dstFamily,
+        VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    uint32_t memoryType = 0;
+    uint32_t computeFamily = 0;
+    uint32_t graphicsFamily = 0;
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    VkSemaphore graphicsTimeline = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    uint32_t count = 0;
+
+    VkBuffer stateBuffer = VK_NULL_HANDLE;
+    Allocation stateMemory;
+    std::array<VkBuffer, SLOTS> renderBuffers {};
+    std::array<Allocation, SLOTS> renderMemory {};
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, SLOTS> descriptorSets {};
+    VkPipelineLayout computeLayout = VK_NULL_HANDLE;
+    VkPipeline computePipeline = VK_NULL_HANDLE;
+    VkPipelineLayout renderLayout = VK_NULL_HANDLE;
+    VkPipeline renderPipeline = VK_NULL_HANDLE;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::array<VkCommandBuffer, SLOTS> commandBuffers {};
+    Timeline computeTimeline;
+    std::array<uint64_t, SLOTS> releasedValues {};
+    std::array<bool, SLOTS> submitted {};
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    float timestampPeriod = 0.0f;
+    uint64_t timestampMask = 0;
+    bool computeTimeValid = false;
+    double computeTime = 0.0;
+};
@@ -0,0 +1,143 @@
+#include "PipelineCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+const uint32_t CACHE_MAGIC = 0x43504b56; // "VKPC"
+const uint32_t CACHE_VERSION = 1;
+
+uint64_t fnv1a(const char* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// The driver's own VkPipelineCacheHeaderVersionOne must agree with the
+// device too; a mismatch means the blob was produced elsewhere.
+bool driverHeaderMatches(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties)
+{
+    if (data.size() < 16 + VK_UUID_SIZE)
+        return false;
+    uint32_t header[4];
+    std::memcpy(header, data.data(), sizeof(header));
+    return header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header[2] == properties.vendorID
+        && header[3] == properties.deviceID
+        && std::memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+}
+
+PipelineCache::FileHeader PipelineCache::expectedHeader() const
+{
+    FileHeader header {};
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.vendorID = properties.vendorID;
+    header.deviceID = properties.deviceID;
+    header.driverVersion = properties.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+void PipelineCache::init(VkPhysicalDevice physicalDevice, VkDevice vkDevice, const std::string& cachePath)
+{
+    device = vkDevice;
+    path = cachePath;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    std::vector<char> data;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+        auto fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+        FileHeader header {};
+        FileHeader expected = expectedHeader();
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        // The size is checked against the file before anything is allocated
+        // for it, so a truncated or damaged header cannot ask for gigabytes.
+        bool valid = file.gcount() == sizeof(header)
+            && header.dataSize == fileSize - sizeof(header)
+            && header.magic == expected.magic
+            && header.version == expected.version
+            && header.vendorID == expected.vendorID
+            && header.deviceID == expected.deviceID
+            && header.driverVersion == expected.driverVersion
+            && std::memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        if (valid) {
+            data.resize(header.dataSize);
+            file.read(data.data(), static_cast<std::streamsize>(data.size()));
+            valid = static_cast<uint64_t>(file.gcount()) == header.dataSize
+                && fnv1a(data.data(), data.size()) == header.checksum
+                && driverHeaderMatches(data, properties);
+        }
+        if (!valid) {
+            std::cout << "pipeline cache " << path << " is stale or corrupt, starting cold\n";
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+    loaded = !data.empty();
+}
+
+void PipelineCache::save() const
+{
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0)
+        return;
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS)
+        return;
+    data.resize(size);
+
+    FileHeader header = expectedHeader();
+    header.dataSize = data.size();
+    header.checksum = fnv1a(data.data(), data.size());
+
+    std::string tempPath = path + ".tmp";
+    std::FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "failed to write pipeline cache " << tempPath << '\n';
+        return;
+    }
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(data.data(), 1, data.size(), file) == data.size()
+        && std::fflush(file) == 0;
+#ifndef _WIN32
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    std::fclose(file);
+
+    std::error_code error;
+    if (written)
+        std::filesystem::rename(tempPath, path, error);
+    if (!written || error) {
+        std::cerr << "failed to write pipeline cache " << path << '\n';
+        std::filesystem::remove(tempPath, error);
+    }
+}
+
+void PipelineCache::destroy()
+{
+    vkDestroyPipelineCache(device, cache, nullptr);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <vulkan/vulkan_core.h>
+
+// A VkPipelineCache persisted across runs. The blob on disk carries its own
+// header (vendor, device, driver version, pipelineCacheUUID and a checksum)
+// so data from another GPU or driver is discarded instead of handed to the
+// driver, and it is written to a temporary file and renamed into place so a
+// crash mid-save never leaves a truncated cache behind.
+class PipelineCache {
+public:
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path);
+    void save() const;
+    void destroy();
+
+    VkPipelineCache handle() const { return cache; }
+    bool warm() const { return loaded; }
+
+private:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t checksum;
+    };
+
+    FileHeader expectedHeader() const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties {};
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    std::string path;
+    bool loaded = false;
+};
@@ -0,0 +1,704 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+    | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT
+    | VK_ACCESS_MEMORY_WRITE_BIT;
+
+bool discards(VkAttachmentLoadOp loadOp)
+{
+    return loadOp != VK_ATTACHMENT_LOAD_OP_LOAD;
+}
+
+void recordBarriers(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+    const VkMemoryBarrier& memory, const std::vector<VkImageMemoryBarrier>& images)
+{
+    if (srcStages == 0 && dstStages == 0)
+        return;
+    // Nothing to wait for, as for the first use of an image imported in an
+    // undefined state, still has to name a source stage.
+    if (srcStages == 0)
+        srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    bool memoryBarrier = memory.srcAccessMask != 0 || memory.dstAccessMask != 0;
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0,
+        memoryBarrier ? 1 : 0, memoryBarrier ? &memory : nullptr, 0, nullptr,
+        static_cast<uint32_t>(images.size()), images.data());
+}
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(RenderResource resource, const ResourceUsage& usage)
+{
+    graph.passes[pass].accesses.push_back({ resource, usage, true, false, false });
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(RenderResource resource, const ResourceUsage& usage)
+{
+    graph.passes[pass].accesses.push_back({ resource, usage, false, true, false });
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::colorAttachment(RenderResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clear)
+{
+    Pass& target = graph.passes[pass];
+    target.accesses.push_back({ resource, USAGE_COLOR_ATTACHMENT, !discards(loadOp), true, discards(loadOp) });
+    Attachment attachment { resource, loadOp, VK_ATTACHMENT_STORE_OP_STORE, {}, false };
+    attachment.clear.color = clear;
+    target.attachments.push_back(attachment);
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::depthAttachment(RenderResource resource, VkAttachmentLoadOp loadOp, VkClearDepthStencilValue clear)
+{
+    Pass& target = graph.passes[pass];
+    target.accesses.push_back({ resource, USAGE_DEPTH_ATTACHMENT, !discards(loadOp), true, discards(loadOp) });
+    Attachment attachment { resource, loadOp, VK_ATTACHMENT_STORE_OP_STORE, {}, true };
+    attachment.clear.depthStencil = clear;
+    target.attachments.push_back(attachment);
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::secondaryCommandBuffers()
+{
+    graph.passes[pass].secondary = true;
+    return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::sideEffect()
+{
+    graph.passes[pass].sideEffect = true;
+    return *this;
+}
+
+void RenderGraph::init(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator& allocator, DeletionQueue& deletions)
+{
+    this->device = device;
+    this->allocator = &allocator;
+    this->deletions = &deletions;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+}
+
+void RenderGraph::useDynamicRendering(PFN_vkCmdBeginRendering beginRendering, PFN_vkCmdEndRendering endRendering)
+{
+    cmdBeginRendering = beginRendering;
+    cmdEndRendering = endRendering;
+}
+
+void RenderGraph::destroy()
+{
+    for (const auto& framebuffer : framebuffers)
+        vkDestroyFramebuffer(device, framebuffer.handle, nullptr);
+    framebuffers.clear();
+    for (const auto& renderPass : renderPasses)
+        vkDestroyRenderPass(device, renderPass.handle, nullptr);
+    renderPasses.clear();
+    destroyTransientSet(transients);
+}
+
+void RenderGraph::releaseFramebuffers()
+{
+    if (framebuffers.empty())
+        return;
+    std::vector<VkFramebuffer> handles;
+    for (const auto& framebuffer : framebuffers)
+        handles.push_back(framebuffer.handle);
+    framebuffers.clear();
+    deletions->push([device = device, handles] {
+        for (auto framebuffer : handles)
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+    });
+}
+
+void RenderGraph::reset()
+{
+    passes.clear();
+    resources.clear();
+    order.clear();
+    finalBarriers = {};
+}
+
+RenderResource RenderGraph::importImage(const char* name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+    const ResourceUsage& initial, std::optional<ResourceUsage> final, VkImageAspectFlags aspect)
+{
+    Resource resource;
+    resource.name = name;
+    resource.image = true;
+    resource.handle = image;
+    resource.view = view;
+    resource.format = format;
+    resource.extent = extent;
+    resource.aspect = aspect;
+    resource.initial = initial;
+    resource.final = final;
+    resources.push_back(std::move(resource));
+    return static_cast<RenderResource>(resources.size() - 1);
+}
+
+RenderResource RenderGraph::importBuffer(const char* name, VkBuffer buffer)
+{
+    Resource resource;
+    resource.name = name;
+    resource.buffer = buffer;
+    resources.push_back(std::move(resource));
+    return static_cast<RenderResource>(resources.size() - 1);
+}
+
+RenderResource RenderGraph::createImage(const char* name, const TransientImageInfo& info)
+{
+    Resource resource;
+    resource.name = name;
+    resource.image = true;
+    resource.transient = true;
+    resource.format = info.format;
+    resource.extent = info.extent;
+    resource.usage = info.usage;
+    resource.aspect = info.aspect;
+    resources.push_back(std::move(resource));
+    return static_cast<RenderResource>(resources.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const char* name, std::function<void(const RenderPassContext&)> execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes.push_back(std::move(pass));
+    return PassBuilder(*this, static_cast<uint32_t>(passes.size() - 1));
+}
+
+void RenderGraph::compile()
+{
+    cullPasses();
+    computeLifetimes();
+    allocateTransients();
+    buildBarriers();
+    for (uint32_t index : order) {
+        Pass& pass = passes[index];
+        if (pass.attachments.empty())
+            continue;
+        pass.extent = resources[pass.attachments.front().resource].extent;
+        for (const Attachment& attachment : pass.attachments) {
+            if (attachment.depth)
+                pass.depthFormat = resources[attachment.resource].format;
+            else
+                pass.colorFormats.push_back(resources[attachment.resource].format);
+        }
+        if (cmdBeginRendering)
+            continue;
+        pass.renderPass = getRenderPass(pass);
+        pass.framebuffer = getFramebuffer(pass);
+    }
+}
+
+// Walks the passes backwards with the set of resources whose current
+// contents someone still needs. A pass lives if it writes one of them; its
+// reads then become needed, and whatever it overwrites completely stops
+// being needed before it.
+void RenderGraph::cullPasses()
+{
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t i = 0; i < resources.size(); i++)
+        needed[i] = resources[i].final.has_value();
+
+    for (size_t p = passes.size(); p-- > 0;) {
+        Pass& pass = passes[p];
+        pass.live = pass.sideEffect;
+        for (const Access& access : pass.accesses)
+            pass.live = pass.live || (access.writes && needed[access.resource]);
+        if (!pass.live)
+            continue;
+        for (const Access& access : pass.accesses) {
+            if (access.discards)
+                needed[access.resource] = false;
+        }
+        for (const Access& access : pass.accesses) {
+            if (access.reads)
+                needed[access.resource] = true;
+        }
+    }
+
+    for (uint32_t p = 0; p < passes.size(); p++) {
+        if (passes[p].live)
+            order.push_back(p);
+    }
+}
+
+void RenderGraph::computeLifetimes()
+{
+    for (uint32_t position = 0; position < order.size(); position++) {
+        for (const Access& access : passes[order[position]].accesses) {
+            Resource& resource = resources[access.resource];
+            if (resource.firstPass == UINT32_MAX)
+                resource.firstPass = position;
+            if (resource.lastPass != position) {
+                resource.lastStages = 0;
+                resource.lastAccess = 0;
+            }
+            resource.lastPass = position;
+            resource.lastStages |= access.usage.stages;
+            resource.lastAccess |= access.usage.access;
+        }
+    }
+
+    // A transient attachment nobody reads after the pass that wrote it need
+    // not be written back to memory.
+    for (uint32_t position = 0; position < order.size(); position++) {
+        for (Attachment& attachment : passes[order[position]].attachments) {
+            const Resource& resource = resources[attachment.resource];
+            bool readLater = !resource.transient;
+            for (uint32_t later = position + 1; later < order.size() && !readLater; later++) {
+                for (const Access& access : passes[order[later]].accesses)
+                    readLater = readLater || (access.resource == attachment.resource && access.reads);
+            }
+            attachment.storeOp = readLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        }
+    }
+}
+
+// Transient images are packed into as few memory slots as possible by
+// packTransients. The images and their memory are kept until the set of
+// transients or their lifetimes change.
+void RenderGraph::allocateTransients()
+{
+    std::vector<RenderResource> live;
+    std::string signature;
+    for (RenderResource r = 0; r < resources.size(); r++) {
+        const Resource& resource = resources[r];
+        if (!resource.transient || resource.firstPass == UINT32_MAX)
+            continue;
+        live.push_back(r);
+        signature += resource.name + ':' + std::to_string(resource.format) + ':' + std::to_string(resource.extent.width) + 'x'
+            + std::to_string(resource.extent.height) + ':' + std::to_string(resource.usage) + ':' + std::to_string(resource.aspect) + ':'
+            + std::to_string(resource.firstPass) + '-' + std::to_string(resource.lastPass) + ';';
+    }
+
+    if (signature != transients.signature) {
+        if (!transients.images.empty()) {
+            // Earlier frames may still be rendering into the old set, and
+            // framebuffers naming its views must not outlive it.
+            releaseFramebuffers();
+            deletions->push([this, retired = std::move(transients)]() mutable { destroyTransientSet(retired); });
+        }
+        transients = {};
+        transients.signature = signature;
+
+        std::vector<TransientLifetime> lifetimes(live.size());
+        for (size_t i = 0; i < live.size(); i++) {
+            const Resource& resource = resources[live[i]];
+            VkImageCreateInfo imageInfo {};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = resource.format;
+            imageInfo.extent = { resource.extent.width, resource.extent.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = resource.usage;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkImage image;
+            if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create transient image!");
+            }
+            transients.images.push_back(image);
+            vkGetImageMemoryRequirements(device, image, &lifetimes[i].requirements);
+            lifetimes[i].firstPass = resource.firstPass;
+            lifetimes[i].lastPass = resource.lastPass;
+            transients.unaliasedBytes += lifetimes[i].requirements.size;
+        }
+
+        std::vector<VkMemoryRequirements> slots;
+        transients.slotOf = packTransients(lifetimes, slots);
+        for (const VkMemoryRequirements& slot : slots) {
+            uint32_t memoryType = deviceLocalMemoryType(slot.memoryTypeBits);
+            transients.slots.push_back(allocator->allocate(slot, memoryType, AllocationKind::Optimal));
+            transients.aliasedBytes += slot.size;
+        }
+        for (size_t i = 0; i < live.size(); i++) {
+            const Resource& resource = resources[live[i]];
+            const Allocation& memory = transients.slots[transients.slotOf[i]];
+            vkBindImageMemory(device, transients.images[i], memory.memory, memory.offset);
+
+            VkImageViewCreateInfo viewInfo {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = transients.images[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = resource.format;
+            viewInfo.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+            VkImageView view;
+            if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create transient image view!");
+            }
+            transients.views.push_back(view);
+        }
+    }
+
+    for (size_t i = 0; i < live.size(); i++) {
+        Resource& resource = resources[live[i]];
+        resource.handle = transients.images[i];
+        resource.view = transients.views[i];
+        resource.slot = transients.slotOf[i];
+    }
+
+    // Whatever last used a slot, in this frame or, for its first occupant,
+    // at the end of the previous one, has to finish before the next
+    // occupant's first use, and its writes have to be made available before
+    // that use writes the same memory; that is the "initial" state of each
+    // transient.
+    for (size_t i = 0; i < live.size(); i++) {
+        Resource& resource = resources[live[i]];
+        const Resource* previous = nullptr;
+        const Resource* last = &resource;
+        for (size_t j = 0; j < live.size(); j++) {
+            const Resource& other = resources[live[j]];
+            if (other.slot != resource.slot)
+                continue;
+            if (other.lastPass < resource.firstPass && (!previous || other.lastPass > previous->lastPass))
+                previous = &other;
+            if (other.lastPass > last->lastPass)
+                last = &other;
+        }
+        const Resource* occupant = previous ? previous : last;
+        resource.initial = { occupant->lastStages, occupant->lastAccess & WRITE_ACCESS, VK_IMAGE_LAYOUT_UNDEFINED };
+    }
+}
+
+std::vector<uint32_t> RenderGraph::packTransients(const std::vector<TransientLifetime>& transients, std::vector<VkMemoryRequirements>& slots)
+{
+    std::vector<std::vector<size_t>> occupants;
+    std::vector<size_t> bySize(transients.size());
+    for (size_t i = 0; i < transients.size(); i++)
+        bySize[i] = i;
+    std::stable_sort(bySize.begin(), bySize.end(),
+        [&](size_t a, size_t b) { return transients[a].requirements.size > transients[b].requirements.size; });
+
+    slots.clear();
+    std::vector<uint32_t> slotOf(transients.size(), 0);
+    for (size_t i : bySize) {
+        const TransientLifetime& transient = transients[i];
+        auto fits = [&](size_t slot) {
+            if ((slots[slot].memoryTypeBits & transient.requirements.memoryTypeBits) == 0)
+                return false;
+            return std::all_of(occupants[slot].begin(), occupants[slot].end(), [&](size_t other) {
+                const TransientLifetime& occupant = transients[other];
+                return occupant.lastPass < transient.firstPass || transient.lastPass < occupant.firstPass;
+            });
+        };
+        size_t slot = 0;
+        while (slot < slots.size() && !fits(slot))
+            slot++;
+        if (slot == slots.size()) {
+            slots.push_back(transient.requirements);
+            occupants.emplace_back();
+        } else {
+            slots[slot].size = std::max(slots[slot].size, transient.requirements.size);
+            slots[slot].alignment = std::max(slots[slot].alignment, transient.requirements.alignment);
+            slots[slot].memoryTypeBits &= transient.requirements.memoryTypeBits;
+        }
+        occupants[slot].push_back(i);
+        slotOf[i] = static_cast<uint32_t>(slot);
+    }
+    return slotOf;
+}
+
+void RenderGraph::buildBarriers()
+{
+    std::vector<ResourceState> states(resources.size());
+    for (size_t r = 0; r < resources.size(); r++) {
+        states[r].layout = resources[r].initial.layout;
+        states[r].writeStages = resources[r].initial.stages;
+        states[r].writeAccess = resources[r].initial.access;
+    }
+    for (uint32_t index : order) {
+        Pass& pass = passes[index];
+        for (const Access& access : pass.accesses)
+            addBarrier(pass.barriers, resources[access.resource], states[access.resource], access.usage, access.writes, access.discards);
+    }
+    for (size_t r = 0; r < resources.size(); r++) {
+        if (resources[r].final)
+            addBarrier(finalBarriers, resources[r], states[r], *resources[r].final, false, false);
+    }
+}
+
+// Adds what `usage` needs to wait for to `barriers` and advances `state`:
+//   - a layout change is an image barrier from every earlier access;
+//   - a write waits for the last write (WAW) and every read since (WAR);
+//   - a read waits for the last write, unless an earlier read through the
+//     same stages and accesses already did (RAR needs nothing).
+void RenderGraph::addBarrier(Barriers& barriers, const Resource& resource, ResourceState& state, const ResourceUsage& usage, bool writes, bool discard)
+{
+    VkPipelineStageFlags waitStages = state.writeStages | state.readStages;
+    if (resource.image && state.layout != usage.layout) {
+        VkImageMemoryBarrier barrier {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        // Discarded contents still need their writes ordered before ours.
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.dstAccessMask = usage.access;
+        barrier.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+        barrier.newLayout = usage.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.handle;
+        barrier.subresourceRange = { resource.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+        barriers.images.push_back(barrier);
+        barriers.srcStages |= waitStages;
+        barriers.dstStages |= usage.stages;
+        // The transition is itself a write that later accesses must see. The
+        // barrier makes it visible to this usage, but not whatever this
+        // usage writes on top of it.
+        state.layout = usage.layout;
+        state.writeStages = usage.stages;
+        state.writeAccess = usage.access & WRITE_ACCESS;
+        state.readStages = writes ? 0 : usage.stages;
+        state.readAccess = writes ? 0 : usage.access;
+        return;
+    }
+
+    if (writes) {
+        if (waitStages != 0) {
+            barriers.srcStages |= waitStages;
+            barriers.dstStages |= usage.stages;
+            barriers.memory.srcAccessMask |= state.writeAccess;
+            barriers.memory.dstAccessMask |= usage.access;
+        }
+        // Nothing has seen this write yet, not even the stage that made it.
+        state.writeStages = usage.stages;
+        state.writeAccess = usage.access & WRITE_ACCESS;
+        state.readStages = 0;
+        state.readAccess = 0;
+        return;
+    }
+
+    bool visible = (usage.stages & ~state.readStages) == 0 && (usage.access & ~state.readAccess) == 0;
+    if (state.writeStages != 0 && !visible) {
+        barriers.srcStages |= state.writeStages;
+        barriers.dstStages |= usage.stages;
+        barriers.memory.srcAccessMask |= state.writeAccess;
+        barriers.memory.dstAccessMask |= usage.access;
+    }
+    state.readStages |= usage.stages;
+    state.readAccess |= usage.access;
+}
+
+// One single-subpass render pass per distinct attachment set. The graph has
+// already put every attachment in its subpass layout, so the render pass
+// transitions nothing and needs no external dependencies.
+VkRenderPass RenderGraph::getRenderPass(const Pass& pass)
+{
+    std::vector<uint64_t> key;
+    for (const Attachment& attachment : pass.attachments) {
+        key.push_back(resources[attachment.resource].format);
+        key.push_back(attachment.loadOp);
+        key.push_back(attachment.storeOp);
+        key.push_back(attachment.depth);
+    }
+    for (const auto& cached : renderPasses) {
+        if (cached.key == key)
+            return cached.handle;
+    }
+
+    std::vector<VkAttachmentDescription> descriptions;
+    std::vector<VkAttachmentReference> colorReferences;
+    VkAttachmentReference depthReference {};
+    bool hasDepth = false;
+    for (const Attachment& attachment : pass.attachments) {
+        VkImageLayout layout = attachment.depth ? USAGE_DEPTH_ATTACHMENT.layout : USAGE_COLOR_ATTACHMENT.layout;
+        VkAttachmentDescription description {};
+        description.format = resources[attachment.resource].format;
+        description.samples = VK_SAMPLE_COUNT_1_BIT;
+        description.loadOp = attachment.loadOp;
+        description.storeOp = attachment.storeOp;
+        description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.initialLayout = layout;
+        description.finalLayout = layout;
+        VkAttachmentReference reference { static_cast<uint32_t>(descriptions.size()), layout };
+        descriptions.push_back(description);
+        if (attachment.depth) {
+            depthReference = reference;
+            hasDepth = true;
+        } else {
+            colorReferences.push_back(reference);
+        }
+    }
+
+    VkSubpassDescription subpass {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+    subpass.pColorAttachments = colorReferences.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+    renderPassInfo.pAttachments = descriptions.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph render pass!");
+    }
+    renderPasses.push_back({ std::move(key), renderPass });
+    return renderPass;
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(const Pass& pass)
+{
+    std::vector<VkImageView> views;
+    for (const Attachment& attachment : pass.attachments)
+        views.push_back(resources[attachment.resource].view);
+    for (const auto& cached : framebuffers) {
+        if (cached.renderPass == pass.renderPass && cached.views == views && cached.extent.width == pass.extent.width
+            && cached.extent.height == pass.extent.height)
+            return cached.handle;
+    }
+
+    VkFramebufferCreateInfo framebufferInfo {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = pass.renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    framebufferInfo.pAttachments = views.data();
+    framebufferInfo.width = pass.extent.width;
+    framebufferInfo.height = pass.extent.height;
+    framebufferInfo.layers = 1;
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph framebuffer!");
+    }
+    framebuffers.push_back({ pass.renderPass, std::move(views), pass.extent, framebuffer });
+    return framebuffer;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    for (uint32_t index : order) {
+        const Pass& pass = passes[index];
+        recordBarriers(commandBuffer, pass.barriers.srcStages, pass.barriers.dstStages, pass.barriers.memory, pass.barriers.images);
+
+        RenderPassContext context;
+        context.commandBuffer = commandBuffer;
+        if (pass.attachments.empty()) {
+            pass.execute(context);
+            continue;
+        }
+
+        context.renderPass = pass.renderPass;
+        context.framebuffer = pass.framebuffer;
+        context.extent = pass.extent;
+        context.colorFormats = pass.colorFormats.data();
+        context.colorAttachmentCount = static_cast<uint32_t>(pass.colorFormats.size());
+        context.depthFormat = pass.depthFormat;
+        if (cmdBeginRendering) {
+            beginRendering(commandBuffer, pass);
+            pass.execute(context);
+            cmdEndRendering(commandBuffer);
+            continue;
+        }
+
+        std::vector<VkClearValue> clearValues;
+        for (const Attachment& attachment : pass.attachments)
+            clearValues.push_back(attachment.clear);
+        VkRenderPassBeginInfo renderPassInfo {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = pass.renderPass;
+        renderPassInfo.framebuffer = pass.framebuffer;
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = pass.extent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+            pass.secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        pass.execute(context);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+    recordBarriers(commandBuffer, finalBarriers.srcStages, finalBarriers.dstStages, finalBarriers.memory, finalBarriers.images);
+}
+
+// The attachments go straight into the begin call, already in the layouts
+// the graph transitioned them to.
+void RenderGraph::beginRendering(VkCommandBuffer commandBuffer, const Pass& pass) const
+{
+    std::vector<VkRenderingAttachmentInfo> colorAttachments;
+    VkRenderingAttachmentInfo depthAttachment {};
+    bool hasDepth = false;
+    for (const Attachment& attachment : pass.attachments) {
+        VkRenderingAttachmentInfo info {};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        info.imageView = resources[attachment.resource].view;
+        info.imageLayout = attachment.depth ? USAGE_DEPTH_ATTACHMENT.layout : USAGE_COLOR_ATTACHMENT.layout;
+        info.resolveMode = VK_RESOLVE_MODE_NONE;
+        info.loadOp = attachment.loadOp;
+        info.storeOp = attachment.storeOp;
+        info.clearValue = attachment.clear;
+        if (attachment.depth) {
+            depthAttachment = info;
+            hasDepth = true;
+        } else {
+            colorAttachments.push_back(info);
+        }
+    }
+
+    VkRenderingInfo renderingInfo {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.flags = pass.secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+    renderingInfo.renderArea.offset = { 0, 0 };
+    renderingInfo.renderArea.extent = pass.extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+    renderingInfo.pColorAttachments = colorAttachments.data();
+    renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+    cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void RenderGraph::printSummary(std::ostream& out) const
+{
+    out << "render graph: " << passes.size() << " passes, " << passes.size() - order.size() << " culled\n";
+    uint32_t barrierCount = 0;
+    for (const Pass& pass : passes) {
+        out << "  " << (pass.live ? "" : "(culled) ") << pass.name;
+        if (pass.live) {
+            bool barrier = !pass.barriers.empty();
+            barrierCount += barrier ? 1 : 0;
+            out << ": " << (barrier ? "barrier" : "no barrier") << ", " << pass.barriers.images.size() << " image transitions";
+            if (!pass.attachments.empty())
+                out << ", " << pass.attachments.size() << " attachments";
+        }
+        out << '\n';
+    }
+    barrierCount += finalBarriers.empty() ? 0 : 1;
+    out << "  final: " << finalBarriers.images.size() << " image transitions\n";
+    out << "  " << barrierCount << " vkCmdPipelineBarrier calls per frame\n";
+    size_t transientCount = 0;
+    for (const Resource& resource : resources)
+        transientCount += resource.transient && resource.firstPass != UINT32_MAX ? 1 : 0;
+    out << "  transient images: " << transientCount << " in " << transients.slots.size() << " allocations, "
+        << transients.aliasedBytes / 1024 << " KiB (" << transients.unaliasedBytes / 1024 << " KiB without aliasing)\n";
+}
+
+void RenderGraph::destroyTransientSet(TransientSet& set)
+{
+    for (auto view : set.views)
+        vkDestroyImageView(device, view, nullptr);
+    for (auto image : set.images)
+        vkDestroyImage(device, image, nullptr);
+    for (auto& allocation : set.slots)
+        allocator->free(allocation);
+    set = {};
+}
+
+uint32_t RenderGraph::deviceLocalMemoryType(uint32_t typeBits) const
+{
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+            return i;
+    }
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if (typeBits & (1u << i))
+            return i;
+    }
+    throw std::runtime_error("failed to find a memory type for transient images!");
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "DeletionQueue.hpp"
+#include "MemoryAllocator.hpp"
+
+// How a pass touches a resource: the stages that do it, with which access
+// and, for images, in which layout.
+struct ResourceUsage {
+    VkPipelineStageFlags stages = 0;
+    VkAccessFlags access = 0;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+const ResourceUsage USAGE_COLOR_ATTACHMENT { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+const ResourceUsage USAGE_DEPTH_ATTACHMENT { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+const ResourceUsage USAGE_FRAGMENT_SAMPLED { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+const ResourceUsage USAGE_COMPUTE_READ { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+const ResourceUsage USAGE_COMPUTE_WRITE { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+const ResourceUsage USAGE_COMPUTE_READ_WRITE { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+const ResourceUsage USAGE_TRANSFER_READ { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+const ResourceUsage USAGE_TRANSFER_WRITE { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+const ResourceUsage USAGE_INDIRECT_READ { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT };
+const ResourceUsage USAGE_VERTEX_READ { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT };
+const ResourceUsage USAGE_PRESENT { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+
+// An image the graph creates and owns. Transient images whose lifetimes in
+// the frame do not overlap share memory.
+struct TransientImageInfo {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent {};
+    VkImageUsageFlags usage = 0;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+using RenderResource = uint32_t;
+
+// What the packing of transient images into shared memory looks at: their
+// memory requirements and the live passes, in execution order, between
+// their first and last use.
+struct TransientLifetime {
+    VkMemoryRequirements requirements {};
+    uint32_t firstPass = 0;
+    uint32_t lastPass = 0;
+};
+
+struct RenderPassContext {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // Set for passes with attachments, whose render pass is already begun.
+    // With dynamic rendering both handles stay null and secondary command
+    // buffers inherit the attachment formats instead.
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkExtent2D extent {};
+    const VkFormat* colorFormats = nullptr;
+    uint32_t colorAttachmentCount = 0;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+};
+
+// Frame graph rebuilt every frame: passes declare what they read and write,
+// compile() drops passes nothing needs, derives the barriers and layout
+// transitions between the rest and places transient images in shared
+// memory, and execute() records it all. Render passes, framebuffers and
+// transient images are cached across frames, so an unchanged graph costs
+// only the bookkeeping.
+//
+// Everything runs on one queue in declaration order; queue family ownership
+// transfers are left to the caller.
+class RenderGraph {
+public:
+    // The dependency recorded before a pass, or after the last one.
+    struct Barriers {
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        VkMemoryBarrier memory { VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, 0, 0 };
+        std::vector<VkImageMemoryBarrier> images;
+        bool empty() const { return srcStages == 0 && dstStages == 0; }
+    };
+
+    class PassBuilder {
+    public:
+        // Reads keep the passes that wrote the resource before alive.
+        PassBuilder& read(RenderResource resource, const ResourceUsage& usage);
+        // A partial write: earlier contents survive and so do their writers.
+        PassBuilder& write(RenderResource resource, const ResourceUsage& usage);
+        // CLEAR and DONT_CARE overwrite the attachment, LOAD also reads it.
+        PassBuilder& colorAttachment(RenderResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clear = {});
+        PassBuilder& depthAttachment(RenderResource resource, VkAttachmentLoadOp loadOp, VkClearDepthStencilValue clear = {});
+        // The render pass is begun for vkCmdExecuteCommands.
+        PassBuilder& secondaryCommandBuffers();
+        // Never culled, whether or not anything reads what it writes.
+        PassBuilder& sideEffect();
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph& graph, uint32_t pass)
+            : graph(graph)
+            , pass(pass)
+        {
+        }
+        RenderGraph& graph;
+        uint32_t pass;
+    };
+
+    // Objects the graph replaces go to `deletions`.
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, MemoryAllocator& allocator, DeletionQueue& deletions);
+    void destroy();
+    // From then on passes with attachments are recorded with
+    // vkCmdBeginRendering, without render pass or framebuffer objects.
+    void useDynamicRendering(PFN_vkCmdBeginRendering beginRendering, PFN_vkCmdEndRendering endRendering);
+    // Framebuffers refer to image views; call when imported views are
+    // retired. The framebuffers are destroyed through the deletion queue.
+    void releaseFramebuffers();
+
+    void reset();
+    // `initial` is the state the image is in when the frame's commands start
+    // (its stages are waited on before the first use); `final`, when given,
+    // is the state it is left in and marks the image as a frame output.
+    RenderResource importImage(const char* name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+        const ResourceUsage& initial, std::optional<ResourceUsage> final, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+    // Imported buffers are assumed to be written outside the graph in ways
+    // already made visible (host writes, uploads waited on by semaphores).
+    RenderResource importBuffer(const char* name, VkBuffer buffer);
+    RenderResource createImage(const char* name, const TransientImageInfo& info);
+    PassBuilder addPass(const char* name, std::function<void(const RenderPassContext&)> execute);
+
+    void compile();
+    void execute(VkCommandBuffer commandBuffer);
+
+    VkImageView imageView(RenderResource resource) const { return resources[resource].view; }
+    void printSummary(std::ostream& out) const;
+
+    // What compile() decided, for tests; `pass` counts addPass calls since
+    // reset().
+    bool passLive(uint32_t pass) const { return passes[pass].live; }
+    const Barriers& passBarriers(uint32_t pass) const { return passes[pass].barriers; }
+    const Barriers& finalTransitions() const { return finalBarriers; }
+
+    // Largest first, each transient goes into the first slot of a compatible
+    // memory type whose occupants are all dead before it is first used or
+    // born after its last use. Returns each transient's slot and fills
+    // `slots` with what each slot's memory has to satisfy.
+    static std::vector<uint32_t> packTransients(const std::vector<TransientLifetime>& transients, std::vector<VkMemoryRequirements>& slots);
+
+private:
+    struct Access {
+        RenderResource resource;
+        ResourceUsage usage;
+        bool reads;
+        bool writes;
+        // Overwrites everything, so earlier contents are never needed.
+        bool discards;
+    };
+    struct Attachment {
+        RenderResource resource;
+        VkAttachmentLoadOp loadOp;
+        VkAttachmentStoreOp storeOp;
+        VkClearValue clear;
+        bool depth;
+    };
+    struct Pass {
+        std::string name;
+        std::function<void(const RenderPassContext&)> execute;
+        std::vector<Access> accesses;
+        std::vector<Attachment> attachments;
+        bool secondary = false;
+        bool sideEffect = false;
+        bool live = false;
+        Barriers barriers;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        VkExtent2D extent {};
+        std::vector<VkFormat> colorFormats;
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    };
+    struct Resource {
+        std::string name;
+        bool image = false;
+        bool transient = false;
+        VkImage handle = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent {};
+        VkImageAspectFlags aspect = 0;
+        VkImageUsageFlags usage = 0;
+        ResourceUsage initial;
+        std::optional<ResourceUsage> final;
+        // Live passes touching it, in execution order; filled by compile().
+        uint32_t firstPass = UINT32_MAX;
+        uint32_t lastPass = 0;
+        // How the last of those passes touched it.
+        VkPipelineStageFlags lastStages = 0;
+        VkAccessFlags lastAccess = 0;
+        uint32_t slot = UINT32_MAX;
+    };
+    // Tracked while barriers are derived.
+    struct ResourceState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        // Stages and accesses that have seen the last write, or read since.
+        VkPipelineStageFlags readStages = 0;
+        VkAccessFlags readAccess = 0;
+    };
+    // The images of one compiled set of transients, and the memory they share.
+    struct TransientSet {
+        std::string signature;
+        std::vector<VkImage> images;
+        std::vector<VkImageView> views;
+        std::vector<Allocation> slots;
+        std::vector<uint32_t> slotOf;
+        VkDeviceSize unaliasedBytes = 0;
+        VkDeviceSize aliasedBytes = 0;
+    };
+
+    void cullPasses();
+    void computeLifetimes();
+    void allocateTransients();
+    void buildBarriers();
+    void addBarrier(Barriers& barriers, const Resource& resource, ResourceState& state, const ResourceUsage& usage, bool writes, bool discard);
+    VkRenderPass getRenderPass(const Pass& pass);
+    VkFramebuffer getFramebuffer(const Pass& pass);
+    void beginRendering(VkCommandBuffer commandBuffer, const Pass& pass) const;
+    void destroyTransientSet(TransientSet& set);
+    uint32_t deviceLocalMemoryType(uint32_t typeBits) const;
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties {};
+    DeletionQueue* deletions = nullptr;
+    PFN_vkCmdBeginRendering cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRendering cmdEndRendering = nullptr;
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    std::vector<uint32_t> order;
+    Barriers finalBarriers;
+
+    struct CachedRenderPass {
+        std::vector<uint64_t> key;
+        VkRenderPass handle;
+    };
+    struct CachedFramebuffer {
+        VkRenderPass renderPass;
+        std::vector<VkImageView> views;
+        VkExtent2D extent;
+        VkFramebuffer handle;
+    };
+    std::vector<CachedRenderPass> renderPasses;
+    std::vector<CachedFramebuffer> framebuffers;
+    TransientSet transients;
+};
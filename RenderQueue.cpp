@@ -0,0 +1,63 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+uint64_t makeDrawKey(uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, float depth)
+{
+    uint32_t depthBits;
+    depth = std::max(depth, 0.0f);
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    return (static_cast<uint64_t>(pipeline & 0xff) << 56) | (static_cast<uint64_t>(descriptorSet & 0xffff) << 40)
+        | (static_cast<uint64_t>(mesh & 0xffff) << 24) | (depthBits >> 8);
+}
+
+DrawItem* RenderQueue::begin(size_t capacity)
+{
+    if (items.size() < capacity) {
+        items.resize(capacity);
+        scratch.resize(capacity);
+    }
+    itemCount = 0;
+    return items.data();
+}
+
+void RenderQueue::sort()
+{
+    skipped = 0;
+    if (itemCount < 2)
+        return;
+
+    // All eight histograms in one read of the keys.
+    std::array<std::array<uint32_t, 256>, 8> histograms {};
+    for (size_t i = 0; i < itemCount; i++) {
+        uint64_t key = items[i].key;
+        for (uint32_t pass = 0; pass < 8; pass++)
+            histograms[pass][(key >> (pass * 8)) & 0xff]++;
+    }
+
+    DrawItem* src = items.data();
+    DrawItem* dst = scratch.data();
+    for (uint32_t pass = 0; pass < 8; pass++) {
+        auto& histogram = histograms[pass];
+        uint32_t firstByte = (src[0].key >> (pass * 8)) & 0xff;
+        if (histogram[firstByte] == itemCount) {
+            skipped++;
+            continue;
+        }
+        uint32_t offset = 0;
+        for (auto& count : histogram) {
+            uint32_t bucket = count;
+            count = offset;
+            offset += bucket;
+        }
+        for (size_t i = 0; i < itemCount; i++)
+            dst[histogram[(src[i].key >> (pass * 8)) & 0xff]++] = src[i];
+        std::swap(src, dst);
+    }
+    // After an odd number of passes the sorted items are in the scratch
+    // buffer, which simply becomes the item buffer.
+    if (src != items.data())
+        items.swap(scratch);
+}
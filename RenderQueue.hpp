@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sort key of a draw, most significant field first, so that sorted draws
+// come grouped by pipeline, then descriptor set, then mesh, and front to back
+// within a group:
+//
+//   63..56 pipeline | 55..40 descriptor set | 39..24 mesh | 23..0 depth
+//
+// Fields are indices into whatever tables the recorder keeps; depth is the
+// top 24 bits of a non-negative float, whose bit patterns order like the
+// values themselves.
+uint64_t makeDrawKey(uint32_t pipeline, uint32_t descriptorSet, uint32_t mesh, float depth);
+
+inline uint32_t drawKeyPipeline(uint64_t key) { return static_cast<uint32_t>(key >> 56); }
+inline uint32_t drawKeyDescriptorSet(uint64_t key) { return static_cast<uint32_t>(key >> 40) & 0xffff; }
+inline uint32_t drawKeyMesh(uint64_t key) { return static_cast<uint32_t>(key >> 24) & 0xffff; }
+
+struct DrawItem {
+    uint64_t key;
+    // What to draw, for the recorder to look up (an object index here).
+    uint32_t payload;
+};
+
+// The draws of one frame. Items are written in any order, by any number of
+// jobs into disjoint slots, then sorted once with an LSD radix sort: eight
+// byte-wide passes, minus those whose byte is the same for every item, which
+// with few pipelines and meshes is most of the high ones.
+class RenderQueue {
+public:
+    // Makes room for `capacity` items and returns where to write them; the
+    // queue holds none until end().
+    DrawItem* begin(size_t capacity);
+    void end(size_t count) { itemCount = count; }
+
+    void sort();
+
+    const DrawItem* data() const { return items.data(); }
+    size_t size() const { return itemCount; }
+    // Sort passes the last sort() skipped.
+    uint32_t skippedPasses() const { return skipped; }
+
+private:
+    std::vector<DrawItem> items;
+    std::vector<DrawItem> scratch;
+    size_t itemCount = 0;
+    uint32_t skipped = 0;
+};
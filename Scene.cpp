@@ -0,0 +1,55 @@
+#include "Scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+std::vector<SceneObject> createGridScene(uint32_t count)
+{
+    auto side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+    float cell = 2.0f / static_cast<float>(side);
+    std::vector<SceneObject> objects(count);
+    for (uint32_t i = 0; i < count; i++) {
+        auto& object = objects[i];
+        object.position = glm::vec3(-1.0f + cell * (static_cast<float>(i % side) + 0.5f),
+            -1.0f + cell * (static_cast<float>(i / side) + 0.5f), 0.0f);
+        object.scale = std::min(1.0f, cell * 0.5f);
+        object.spin = (i % 2 == 0) ? 1.0f : -1.0f;
+        object.color = glm::vec3(0.5f + 0.5f * object.position.x, 0.5f + 0.5f * object.position.y, 1.0f);
+    }
+    return objects;
+}
+
+glm::mat4 objectTransform(const SceneObject& object, float time)
+{
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), object.position);
+    model = glm::rotate(model, time * glm::radians(90.0f) * object.spin, glm::vec3(0.0f, 0.0f, 1.0f));
+    return glm::scale(model, glm::vec3(object.scale));
+}
+
+Frustum extractFrustum(const glm::mat4& viewProj)
+{
+    // Gribb/Hartmann: each plane is a sum or difference of the rows of the
+    // clip matrix (glm stores columns, hence the transpose).
+    glm::mat4 rows = glm::transpose(viewProj);
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+    for (auto& plane : frustum.planes)
+        plane = plane * (1.0f / glm::length(glm::vec3(plane.x, plane.y, plane.z)));
+    return frustum;
+}
+
+bool sphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius)
+{
+    for (const auto& plane : frustum.planes) {
+        if (glm::dot(glm::vec3(plane.x, plane.y, plane.z), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
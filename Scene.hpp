@@ -0,0 +1,30 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct SceneObject {
+    glm::vec3 position;
+    float scale;
+    float spin;
+    glm::vec3 color;
+};
+
+// Plane equations (xyz normal pointing inwards, w distance) in world space.
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+};
+
+// Radius of the sphere around a unit quad centred on the origin.
+const float QUAD_BOUNDING_RADIUS = 0.70710678f;
+
+// Lays count objects out on a square grid covering [-1, 1] in x and y.
+std::vector<SceneObject> createGridScene(uint32_t count);
+glm::mat4 objectTransform(const SceneObject& object, float time);
+
+// Extracts the planes of a [0, 1] depth range clip transform.
+Frustum extractFrustum(const glm::mat4& viewProj);
+bool sphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius);
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+std::vector<char> readFile(const std::string& filename);
+VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code);
+// A module from SPIR-V on disk, e.g. "shaders/vert.spv"; throws if the file
+// cannot be read.
+VkShaderModule loadShaderModule(VkDevice device, const std::string& path);
@@ -0,0 +1,50 @@
+#pragma once
+
+// x86 SIMD support for the CPU-side kernels. SSE2 is part of x86-64, so
+// kernels use it unconditionally there; AVX and AVX2 versions are compiled
+// per function with target attributes and picked at run time, so the
+// executable still runs on CPUs without them. Other architectures get the
+// scalar kernels.
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#define SIMD_TARGET_AVX __attribute__((target("avx")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define SIMD_X86 0
+#endif
+
+enum class SimdLevel {
+    Scalar,
+    Sse,
+    Avx,
+    Avx2,
+};
+
+inline SimdLevel detectSimdLevel()
+{
+#if SIMD_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SimdLevel::Avx2;
+    if (__builtin_cpu_supports("avx"))
+        return SimdLevel::Avx;
+    return SimdLevel::Sse;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+inline const char* simdLevelName(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::Sse:
+        return "sse";
+    case SimdLevel::Avx:
+        return "avx";
+    case SimdLevel::Avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
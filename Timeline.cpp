@@ -0,0 +1,86 @@
+#include "Timeline.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void Timeline::init(VkDevice vkDevice)
+{
+    device = vkDevice;
+    submittedValue = 0;
+    completedValue = 0;
+
+    VkSemaphoreTypeCreateInfo typeInfo {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreInfo {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &handle) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+    }
+}
+
+void Timeline::destroy()
+{
+    vkDestroySemaphore(device, handle, nullptr);
+    handle = VK_NULL_HANDLE;
+}
+
+uint64_t Timeline::completed()
+{
+    uint64_t value = 0;
+    if (vkGetSemaphoreCounterValue(device, handle, &value) != VK_SUCCESS) {
+        throw std::runtime_error("failed to read timeline semaphore!");
+    }
+    completedValue = std::max(completedValue, value);
+    return completedValue;
+}
+
+bool Timeline::wait(uint64_t value, uint64_t timeout)
+{
+    if (value <= completedValue)
+        return true;
+    VkSemaphoreWaitInfo waitInfo {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &handle;
+    waitInfo.pValues = &value;
+    VkResult result = vkWaitSemaphores(device, &waitInfo, timeout);
+    if (result == VK_TIMEOUT)
+        return false;
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for timeline semaphore!");
+    }
+    completedValue = std::max(completedValue, value);
+    return true;
+}
+
+void SubmitSemaphores::wait(VkSemaphore semaphore, VkPipelineStageFlags stages, uint64_t value)
+{
+    waits.push_back(semaphore);
+    waitStages.push_back(stages);
+    waitValues.push_back(value);
+}
+
+void SubmitSemaphores::signal(VkSemaphore semaphore, uint64_t value)
+{
+    signals.push_back(semaphore);
+    signalValues.push_back(value);
+}
+
+void SubmitSemaphores::apply(VkSubmitInfo& submitInfo, VkTimelineSemaphoreSubmitInfo& timelineInfo) const
+{
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.pNext = submitInfo.pNext;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waits.size());
+    submitInfo.pWaitSemaphores = waits.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signals.size());
+    submitInfo.pSignalSemaphores = signals.data();
+}
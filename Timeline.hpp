@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// A timeline semaphore counting the submissions of one queue. Every
+// submission that others may wait for signals the next value, so "has the
+// queue got this far" is a single counter read and any number of pending
+// submissions is tracked without a fence each.
+class Timeline {
+public:
+    void init(VkDevice device);
+    void destroy();
+
+    VkSemaphore semaphore() const { return handle; }
+    // Reserves the value the next submission must signal.
+    uint64_t advance() { return ++submittedValue; }
+    uint64_t submitted() const { return submittedValue; }
+
+    uint64_t completed();
+    bool isComplete(uint64_t value) { return value <= completedValue || value <= completed(); }
+    // Returns false on timeout.
+    bool wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkSemaphore handle = VK_NULL_HANDLE;
+    uint64_t submittedValue = 0;
+    uint64_t completedValue = 0;
+};
+
+// The semaphores of one vkQueueSubmit, timeline and binary alike; binary
+// ones (swapchain acquire and present) take a value of 0, which is ignored.
+struct SubmitSemaphores {
+    std::vector<VkSemaphore> waits;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    std::vector<VkSemaphore> signals;
+    std::vector<uint64_t> signalValues;
+
+    void wait(VkSemaphore semaphore, VkPipelineStageFlags stages, uint64_t value = 0);
+    void signal(VkSemaphore semaphore, uint64_t value = 0);
+    // Points submitInfo at the semaphores and chains timelineInfo to it; both
+    // must stay alive until the submit.
+    void apply(VkSubmitInfo& submitInfo, VkTimelineSemaphoreSubmitInfo& timelineInfo) const;
+};
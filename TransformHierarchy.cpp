@@ -0,0 +1,214 @@
+#include "TransformHierarchy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include "JobSystem.hpp"
+
+namespace {
+// out = a * b for column-major 4x4 matrices: column j of the result is the
+// columns of a weighted by the elements of column j of b. out may not alias
+// either input.
+void multiplyScalar(const float* a, const float* b, float* out)
+{
+    for (int j = 0; j < 4; j++) {
+        for (int r = 0; r < 4; r++)
+            out[j * 4 + r] = a[r] * b[j * 4] + a[4 + r] * b[j * 4 + 1] + a[8 + r] * b[j * 4 + 2] + a[12 + r] * b[j * 4 + 3];
+    }
+}
+
+#if SIMD_X86
+void multiplySse(const float* a, const float* b, float* out)
+{
+    __m128 a0 = _mm_loadu_ps(a);
+    __m128 a1 = _mm_loadu_ps(a + 4);
+    __m128 a2 = _mm_loadu_ps(a + 8);
+    __m128 a3 = _mm_loadu_ps(a + 12);
+    for (int j = 0; j < 4; j++) {
+        __m128 column = _mm_loadu_ps(b + j * 4);
+        __m128 result = _mm_mul_ps(a0, _mm_shuffle_ps(column, column, _MM_SHUFFLE(0, 0, 0, 0)));
+        result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_shuffle_ps(column, column, _MM_SHUFFLE(1, 1, 1, 1))));
+        result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_shuffle_ps(column, column, _MM_SHUFFLE(2, 2, 2, 2))));
+        result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_shuffle_ps(column, column, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm_storeu_ps(out + j * 4, result);
+    }
+}
+
+// Two result columns per 256-bit register: a's columns are broadcast to both
+// halves and each half picks its weights from its own column of b.
+SIMD_TARGET_AVX void multiplyAvx(const float* a, const float* b, float* out)
+{
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+    for (int j = 0; j < 4; j += 2) {
+        __m256 columns = _mm256_loadu_ps(b + j * 4);
+        __m256 result = _mm256_mul_ps(a0, _mm256_permute_ps(columns, 0x00));
+        result = _mm256_add_ps(result, _mm256_mul_ps(a1, _mm256_permute_ps(columns, 0x55)));
+        result = _mm256_add_ps(result, _mm256_mul_ps(a2, _mm256_permute_ps(columns, 0xaa)));
+        result = _mm256_add_ps(result, _mm256_mul_ps(a3, _mm256_permute_ps(columns, 0xff)));
+        _mm256_storeu_ps(out + j * 4, result);
+    }
+}
+
+SIMD_TARGET_AVX2 void multiplyAvx2(const float* a, const float* b, float* out)
+{
+    __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+    __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+    __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+    __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+    for (int j = 0; j < 4; j += 2) {
+        __m256 columns = _mm256_loadu_ps(b + j * 4);
+        __m256 result = _mm256_mul_ps(a0, _mm256_permute_ps(columns, 0x00));
+        result = _mm256_fmadd_ps(a1, _mm256_permute_ps(columns, 0x55), result);
+        result = _mm256_fmadd_ps(a2, _mm256_permute_ps(columns, 0xaa), result);
+        result = _mm256_fmadd_ps(a3, _mm256_permute_ps(columns, 0xff), result);
+        _mm256_storeu_ps(out + j * 4, result);
+    }
+}
+#endif
+
+using MultiplyFunction = void (*)(const float*, const float*, float*);
+
+MultiplyFunction multiplyFor(SimdLevel level)
+{
+#if SIMD_X86
+    switch (level) {
+    case SimdLevel::Avx2:
+        return multiplyAvx2;
+    case SimdLevel::Avx:
+        return multiplyAvx;
+    case SimdLevel::Sse:
+        return multiplySse;
+    case SimdLevel::Scalar:
+        break;
+    }
+#else
+    (void)level;
+#endif
+    return multiplyScalar;
+}
+}
+
+uint32_t TransformHierarchy::add(uint32_t parent, const glm::mat4& local)
+{
+    if (parent != NO_PARENT && parent >= slots.size()) {
+        throw std::runtime_error("transform parent does not exist!");
+    }
+    auto handle = static_cast<uint32_t>(slots.size());
+    slots.push_back(static_cast<uint32_t>(parents.size()));
+    handles.push_back(handle);
+    parents.push_back(parent == NO_PARENT ? NO_PARENT : slots[parent]);
+    locals.push_back(local);
+    worlds.push_back(local);
+    dirty.push_back(1);
+    levelStarts.clear();
+    return handle;
+}
+
+void TransformHierarchy::reorder()
+{
+    uint32_t count = size();
+    // Slots already list parents first, so depths come out of one sweep.
+    std::vector<uint32_t> depths(count);
+    uint32_t maxDepth = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        depths[i] = parents[i] == NO_PARENT ? 0 : depths[parents[i]] + 1;
+        maxDepth = std::max(maxDepth, depths[i]);
+    }
+
+    // Counting sort by depth, stable so siblings stay together.
+    levelStarts.assign(count > 0 ? maxDepth + 2 : 0, 0);
+    for (uint32_t i = 0; i < count; i++)
+        levelStarts[depths[i] + 1]++;
+    for (size_t l = 1; l < levelStarts.size(); l++)
+        levelStarts[l] += levelStarts[l - 1];
+    std::vector<uint32_t> newSlots(count);
+    std::vector<uint32_t> next(levelStarts.begin(), levelStarts.end());
+    for (uint32_t i = 0; i < count; i++)
+        newSlots[i] = next[depths[i]]++;
+
+    std::vector<uint32_t> newParents(count);
+    std::vector<glm::mat4> newLocals(count);
+    std::vector<glm::mat4> newWorlds(count);
+    std::vector<uint8_t> newDirty(count);
+    std::vector<uint32_t> newHandles(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t to = newSlots[i];
+        newParents[to] = parents[i] == NO_PARENT ? NO_PARENT : newSlots[parents[i]];
+        newLocals[to] = locals[i];
+        newWorlds[to] = worlds[i];
+        newDirty[to] = dirty[i];
+        newHandles[to] = handles[i];
+        slots[handles[i]] = to;
+    }
+    parents = std::move(newParents);
+    locals = std::move(newLocals);
+    worlds = std::move(newWorlds);
+    dirty = std::move(newDirty);
+    handles = std::move(newHandles);
+}
+
+void TransformHierarchy::clear()
+{
+    parents.clear();
+    locals.clear();
+    worlds.clear();
+    dirty.clear();
+    handles.clear();
+    slots.clear();
+    levelStarts.clear();
+}
+
+void TransformHierarchy::setLocal(uint32_t handle, const glm::mat4& local)
+{
+    uint32_t at = slots[handle];
+    locals[at] = local;
+    dirty[at] = 1;
+}
+
+uint32_t TransformHierarchy::update(glm::mat4* output, JobSystem* jobs)
+{
+    uint32_t updated = 0;
+    if (!jobs || levelStarts.empty()) {
+        updated = updateRange(0, size(), output);
+    } else {
+        // A level only reads the one before it, which is complete by then.
+        std::atomic<uint32_t> total { 0 };
+        for (size_t l = 0; l + 1 < levelStarts.size(); l++) {
+            uint32_t begin = levelStarts[l];
+            uint32_t count = levelStarts[l + 1] - begin;
+            jobs->parallelFor(count, jobs->grainSize(count, 256), [&](uint32_t first, uint32_t end) {
+                total.fetch_add(updateRange(begin + first, begin + end, output), std::memory_order_relaxed);
+            });
+        }
+        updated = total.load();
+    }
+    // Children read their parents' flags, so none can be cleared earlier.
+    std::fill(dirty.begin(), dirty.end(), 0);
+    return updated;
+}
+
+uint32_t TransformHierarchy::updateRange(uint32_t first, uint32_t end, glm::mat4* output)
+{
+    MultiplyFunction multiply = multiplyFor(simdLevel);
+    uint32_t updated = 0;
+    for (uint32_t i = first; i < end; i++) {
+        uint32_t parent = parents[i];
+        if (parent != NO_PARENT)
+            dirty[i] |= dirty[parent];
+        if (!dirty[i])
+            continue;
+        if (parent == NO_PARENT)
+            worlds[i] = locals[i];
+        else
+            multiply(&worlds[parent][0][0], &locals[i][0][0], &worlds[i][0][0]);
+        if (output)
+            std::memcpy(&output[i], &worlds[i], sizeof(glm::mat4));
+        updated++;
+    }
+    return updated;
+}
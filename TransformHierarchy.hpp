@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include "Simd.hpp"
+
+class JobSystem;
+
+// Parent-relative transforms of many nodes, stored as parallel arrays
+// (parent, local, world, dirty) indexed by slot. Slots are kept so that a
+// parent always comes before its children; after reorder() they are also
+// breadth-first, one contiguous range per depth level, so update() is a
+// linear sweep and the nodes of a level can be split across jobs.
+//
+// Nodes are addressed by the handle add() returned, which survives
+// reorder(); world matrices are written out by slot.
+class TransformHierarchy {
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    // `parent` must already exist. Adding invalidates the level ranges until
+    // the next reorder(); updates are still correct, just not parallel.
+    uint32_t add(uint32_t parent, const glm::mat4& local);
+    void reorder();
+    void clear();
+
+    void setLocal(uint32_t handle, const glm::mat4& local);
+    const glm::mat4& world(uint32_t handle) const { return worlds[slots[handle]]; }
+    uint32_t slot(uint32_t handle) const { return slots[handle]; }
+    uint32_t size() const { return static_cast<uint32_t>(parents.size()); }
+    uint32_t levelCount() const { return static_cast<uint32_t>(levelStarts.empty() ? 0 : levelStarts.size() - 1); }
+
+    // Which 4x4 multiply update() uses; defaults to the best the CPU has.
+    void setSimdLevel(SimdLevel level) { simdLevel = level; }
+    SimdLevel simd() const { return simdLevel; }
+
+    // Recomputes the world matrix of every dirty node and everything below
+    // it, copying each one that changed to output[slot] (which may be a
+    // mapped buffer). Returns how many changed. With `jobs` each level is
+    // split across them.
+    uint32_t update(glm::mat4* output, JobSystem* jobs = nullptr);
+
+private:
+    uint32_t updateRange(uint32_t first, uint32_t end, glm::mat4* output);
+
+    // Per slot.
+    std::vector<uint32_t> parents;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> handles;
+    // Per handle.
+    std::vector<uint32_t> slots;
+    // Level l holds slots [levelStarts[l], levelStarts[l + 1]); empty while
+    // the order is not breadth-first.
+    std::vector<uint32_t> levelStarts;
+    SimdLevel simdLevel = detectSimdLevel();
+};
@@ -0,0 +1,46 @@
+#include "UniformRing.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void UniformRing::init(VkDevice vkDevice, MemoryAllocator& memoryAllocator, uint32_t memoryType, VkDeviceSize capacity, VkDeviceSize minOffsetAlignment)
+{
+    device = vkDevice;
+    allocator = &memoryAllocator;
+    alignment = std::max<VkDeviceSize>(minOffsetAlignment, 1);
+    size = capacity;
+    head = 0;
+
+    VkBufferCreateInfo bufferInfo {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &ringBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create uniform ring buffer!");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, ringBuffer, &memRequirements);
+    if (!(memRequirements.memoryTypeBits & (1u << memoryType))) {
+        throw std::runtime_error("memory type not usable for uniform ring buffer!");
+    }
+    memory = allocator->allocate(memRequirements, memoryType, AllocationKind::Linear);
+    vkBindBufferMemory(device, ringBuffer, memory.memory, memory.offset);
+}
+
+void UniformRing::destroy()
+{
+    vkDestroyBuffer(device, ringBuffer, nullptr);
+    allocator->free(memory);
+}
+
+uint32_t UniformRing::allocate(VkDeviceSize blockSize, void** data)
+{
+    VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+    if (offset + blockSize > size) {
+        throw std::runtime_error("uniform ring exhausted!");
+    }
+    head = offset + blockSize;
+    *data = static_cast<char*>(memory.mapped) + offset;
+    return static_cast<uint32_t>(offset);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <vulkan/vulkan_core.h>
+
+#include "MemoryAllocator.hpp"
+
+// One persistently mapped uniform buffer per frame in flight, carved up with a
+// bump allocator. Every block is bound through a
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor using the returned
+// offset, so per-draw constants need neither new buffers nor new sets.
+class UniformRing {
+public:
+    void init(VkDevice device, MemoryAllocator& allocator, uint32_t memoryType, VkDeviceSize capacity, VkDeviceSize minOffsetAlignment);
+    void destroy();
+
+    // Only valid once the GPU is done with everything allocated since the
+    // previous reset, i.e. after the frame's timeline wait.
+    void reset() { head = 0; }
+
+    uint32_t allocate(VkDeviceSize size, void** data);
+    // Stride between consecutive blocks of the given size, for callers that
+    // allocate an array of blocks at once and fill it from several threads.
+    VkDeviceSize alignedSize(VkDeviceSize blockSize) const { return (blockSize + alignment - 1) / alignment * alignment; }
+
+    template <typename T>
+    uint32_t push(const T& value)
+    {
+        void* data;
+        uint32_t offset = allocate(sizeof(T), &data);
+        std::memcpy(data, &value, sizeof(T));
+        return offset;
+    }
+
+    VkBuffer buffer() const { return ringBuffer; }
+    VkDeviceSize capacity() const { return size; }
+    VkDeviceSize used() const { return head; }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    VkBuffer ringBuffer = VK_NULL_HANDLE;
+    Allocation memory;
+    VkDeviceSize size = 0;
+    VkDeviceSize alignment = 1;
+    VkDeviceSize head = 0;
+};
@@ -0,0 +1,225 @@
+#include "UploadManager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+VkBuffer createStagingBuffer(VkDevice device, MemoryAllocator& allocator, uint32_t memoryType, VkDeviceSize size, Allocation& memory)
+{
+    VkBufferCreateInfo bufferInfo {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create staging buffer!");
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    if (!(memRequirements.memoryTypeBits & (1u << memoryType))) {
+        throw std::runtime_error("staging memory type not usable for staging buffer!");
+    }
+    memory = allocator.allocate(memRequirements, memoryType, AllocationKind::Linear);
+    vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+    return buffer;
+}
+}
+
+void UploadManager::init(VkDevice vkDevice, MemoryAllocator& memoryAllocator, uint32_t memoryType, uint32_t queueFamilyIndex, VkQueue transferQueue, VkDeviceSize stagingSize)
+{
+    device = vkDevice;
+    allocator = &memoryAllocator;
+    stagingMemoryType = memoryType;
+    queue = transferQueue;
+
+    VkCommandPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    stagingCapacity = stagingSize;
+    stagingBuffer = createStagingBuffer(device, *allocator, stagingMemoryType, stagingCapacity, stagingMemory);
+    batchTimeline.init(device);
+}
+
+void UploadManager::destroy()
+{
+    while (!inFlight.empty())
+        retireOldest();
+    freeBatches.clear();
+    batchTimeline.destroy();
+    for (auto& [buffer, memory] : pendingOverflow) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(memory);
+    }
+    pendingOverflow.clear();
+    pendingCopies.clear();
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyBuffer(device, stagingBuffer, nullptr);
+    allocator->free(stagingMemory);
+}
+
+UploadToken UploadManager::enqueue(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    PendingCopy copy {};
+    copy.dst = dst;
+    copy.region.dstOffset = dstOffset;
+    copy.region.size = size;
+
+    if (size > stagingCapacity) {
+        // Too large for the ring: give it a staging buffer of its own that is
+        // released with the batch.
+        Allocation memory;
+        copy.src = createStagingBuffer(device, *allocator, stagingMemoryType, size, memory);
+        copy.region.srcOffset = 0;
+        std::memcpy(memory.mapped, data, size);
+        pendingOverflow.emplace_back(copy.src, memory);
+    } else {
+        VkDeviceSize offset;
+        while (!allocateStaging(size, offset)) {
+            retireCompleted();
+            if (allocateStaging(size, offset))
+                break;
+            if (inFlight.empty())
+                flush();
+            if (inFlight.empty()) {
+                throw std::runtime_error("staging ring exhausted with nothing in flight!");
+            }
+            retireOldest();
+        }
+        copy.src = stagingBuffer;
+        copy.region.srcOffset = offset;
+        std::memcpy(static_cast<char*>(stagingMemory.mapped) + offset, data, size);
+    }
+    pendingCopies.push_back(copy);
+    return batchTimeline.submitted() + 1;
+}
+
+UploadToken UploadManager::flush()
+{
+    if (pendingCopies.empty())
+        return batchTimeline.submitted();
+
+    Batch batch = acquireBatch();
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+    // Consecutive copies between the same pair of buffers go out in a single
+    // vkCmdCopyBuffer.
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < pendingCopies.size(); i++) {
+        regions.push_back(pendingCopies[i].region);
+        bool last = i + 1 == pendingCopies.size();
+        if (last || pendingCopies[i + 1].src != pendingCopies[i].src || pendingCopies[i + 1].dst != pendingCopies[i].dst) {
+            vkCmdCopyBuffer(batch.commandBuffer, pendingCopies[i].src, pendingCopies[i].dst, static_cast<uint32_t>(regions.size()), regions.data());
+            regions.clear();
+        }
+    }
+    vkEndCommandBuffer(batch.commandBuffer);
+
+    batch.token = batchTimeline.advance();
+    SubmitSemaphores semaphores;
+    semaphores.signal(batchTimeline.semaphore(), batch.token);
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+    VkTimelineSemaphoreSubmitInfo timelineInfo {};
+    semaphores.apply(submitInfo, timelineInfo);
+    if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit upload batch!");
+    }
+
+    batch.ringEnd = ringHead;
+    batch.overflowBuffers = std::move(pendingOverflow);
+    pendingOverflow.clear();
+    pendingCopies.clear();
+    inFlight.push_back(std::move(batch));
+    return inFlight.back().token;
+}
+
+bool UploadManager::isComplete(UploadToken token)
+{
+    retireCompleted();
+    return token <= completedToken;
+}
+
+void UploadManager::wait(UploadToken token)
+{
+    if (token > batchTimeline.submitted())
+        flush();
+    while (completedToken < token && !inFlight.empty())
+        retireOldest();
+}
+
+bool UploadManager::allocateStaging(VkDeviceSize size, VkDeviceSize& offset)
+{
+    if (ringHead == ringTail) {
+        // Nothing in use: restart at the beginning of the ring so a large
+        // upload does not fail just because the head sits near the end.
+        ringHead = (ringHead + stagingCapacity - 1) / stagingCapacity * stagingCapacity;
+        ringTail = ringHead;
+    }
+    uint64_t start = (ringHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    uint64_t position = start % stagingCapacity;
+    if (position + size > stagingCapacity)
+        start += stagingCapacity - position;
+    if (start + size - ringTail > stagingCapacity)
+        return false;
+    offset = start % stagingCapacity;
+    ringHead = start + size;
+    return true;
+}
+
+void UploadManager::retireCompleted()
+{
+    // One counter read covers every batch in flight.
+    uint64_t completed = batchTimeline.completed();
+    while (!inFlight.empty() && inFlight.front().token <= completed)
+        retireOldest();
+}
+
+void UploadManager::retireOldest()
+{
+    Batch& batch = inFlight.front();
+    batchTimeline.wait(batch.token);
+    completedToken = batch.token;
+    ringTail = std::max(ringTail, batch.ringEnd);
+    for (auto& [buffer, memory] : batch.overflowBuffers) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(memory);
+    }
+    batch.overflowBuffers.clear();
+    freeBatches.push_back(std::move(batch));
+    inFlight.pop_front();
+}
+
+UploadManager::Batch UploadManager::acquireBatch()
+{
+    if (!freeBatches.empty()) {
+        Batch batch = std::move(freeBatches.back());
+        freeBatches.pop_back();
+        vkResetCommandBuffer(batch.commandBuffer, 0);
+        return batch;
+    }
+
+    Batch batch;
+    VkCommandBufferAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+    return batch;
+}
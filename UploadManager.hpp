@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "MemoryAllocator.hpp"
+#include "Timeline.hpp"
+
+// Identifies the batch an upload was submitted with; batches complete in
+// submission order, so a token also covers every earlier upload. Tokens are
+// the values the batches signal on the transfer queue's timeline.
+using UploadToken = uint64_t;
+
+// Streams buffer data to the GPU on a (preferably dedicated) transfer queue.
+// Uploads are copied into a persistently mapped staging ring, recorded as
+// VkBufferCopy regions and submitted together by flush(). The CPU only ever
+// blocks when the ring is full; the GPU side waits on timeline() reaching
+// the token of the uploads it consumes.
+class UploadManager {
+public:
+    static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 32ull * 1024 * 1024;
+    static constexpr VkPipelineStageFlags CONSUMER_WAIT_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+        | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    void init(VkDevice device, MemoryAllocator& allocator, uint32_t stagingMemoryType, uint32_t queueFamilyIndex, VkQueue queue, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+    void destroy();
+
+    UploadToken enqueue(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    // Submits everything queued since the last flush as one batch.
+    UploadToken flush();
+
+    bool isComplete(UploadToken token);
+    void wait(UploadToken token);
+
+    VkSemaphore timeline() const { return batchTimeline.semaphore(); }
+    // Token of the most recently flushed batch, 0 before the first.
+    UploadToken submitted() const { return batchTimeline.submitted(); }
+
+private:
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        UploadToken token = 0;
+        uint64_t ringEnd = 0;
+        std::vector<std::pair<VkBuffer, Allocation>> overflowBuffers;
+    };
+
+    bool allocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+    void retireCompleted();
+    void retireOldest();
+    Batch acquireBatch();
+
+    VkDevice device = VK_NULL_HANDLE;
+    MemoryAllocator* allocator = nullptr;
+    uint32_t stagingMemoryType = 0;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    Allocation stagingMemory;
+    VkDeviceSize stagingCapacity = 0;
+    // Monotonic byte counters; position in the ring is counter % capacity.
+    uint64_t ringHead = 0;
+    uint64_t ringTail = 0;
+
+    struct PendingCopy {
+        VkBuffer src;
+        VkBuffer dst;
+        VkBufferCopy region;
+    };
+    std::vector<PendingCopy> pendingCopies;
+    std::vector<std::pair<VkBuffer, Allocation>> pendingOverflow;
+    UploadToken completedToken = 0;
+
+    Timeline batchTimeline;
+    std::deque<Batch> inFlight;
+    std::vector<Batch> freeBatches;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <vulkan/vulkan_core.h>
+
+// Vertex attribute formats. Each names the VkFormat the pipeline fetches,
+// the bytes it takes in the vertex and how a float value is encoded into
+// them. Every size is a multiple of four so that attributes packed back to
+// back stay aligned.
+
+struct Float2Format {
+    using Value = glm::vec2;
+    static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+    static constexpr uint32_t size = 8;
+    static void encode(const Value& value, void* out) { std::memcpy(out, &value, size); }
+};
+
+struct Float3Format {
+    using Value = glm::vec3;
+    static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+    static constexpr uint32_t size = 12;
+    static void encode(const Value& value, void* out) { std::memcpy(out, &value, size); }
+};
+
+struct Float4Format {
+    using Value = glm::vec4;
+    static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    static constexpr uint32_t size = 16;
+    static void encode(const Value& value, void* out) { std::memcpy(out, &value, size); }
+};
+
+// Half floats keep about three significant digits, plenty for positions of
+// meshes in the unit range.
+struct Half2Format {
+    using Value = glm::vec2;
+    static constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT;
+    static constexpr uint32_t size = 4;
+    static void encode(const Value& value, void* out)
+    {
+        uint16_t halves[2] = { glm::packHalf1x16(value.x), glm::packHalf1x16(value.y) };
+        std::memcpy(out, halves, size);
+    }
+};
+
+// Three-component 16-bit formats are rarely supported for vertex fetch, so
+// a 3D position takes four halves; w is 1.
+struct Half4Format {
+    using Value = glm::vec3;
+    static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    static constexpr uint32_t size = 8;
+    static void encode(const Value& value, void* out)
+    {
+        uint16_t halves[4] = { glm::packHalf1x16(value.x), glm::packHalf1x16(value.y), glm::packHalf1x16(value.z), glm::packHalf1x16(1.0f) };
+        std::memcpy(out, halves, size);
+    }
+};
+
+// Colors in [0, 1]; alpha is 1.
+struct Unorm8x4Format {
+    using Value = glm::vec3;
+    static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    static constexpr uint32_t size = 4;
+    static void encode(const Value& value, void* out)
+    {
+        uint32_t packed = glm::packUnorm4x8(glm::vec4(value, 1.0f));
+        std::memcpy(out, &packed, size);
+    }
+};
+
+// Unit normals folded onto an octahedron and unfolded to a square, two snorm
+// components. The vertex shader decodes them with
+//
+//   vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+//   if (n.z < 0.0)
+//       n.xy = (1.0 - abs(n.yx)) * sign(n.xy);
+//   n = normalize(n);
+struct OctahedralNormalFormat {
+    using Value = glm::vec3;
+    static constexpr VkFormat format = VK_FORMAT_R16G16_SNORM;
+    static constexpr uint32_t size = 4;
+    static glm::vec2 fold(const Value& normal)
+    {
+        glm::vec3 n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+        glm::vec2 e(n.x, n.y);
+        if (n.z < 0.0f) {
+            e = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+        }
+        return e;
+    }
+    static void encode(const Value& value, void* out)
+    {
+        uint32_t packed = glm::packSnorm2x16(fold(value));
+        std::memcpy(out, &packed, size);
+    }
+};
+
+template <uint32_t Location, typename Format>
+struct VertexAttribute {
+    static constexpr uint32_t location = Location;
+    using format = Format;
+};
+
+// A vertex made of Attributes laid out back to back in the order given.
+// Offsets, the stride and the Vulkan descriptions all follow from the type
+// list, so changing a format cannot leave a descriptor behind.
+template <typename... Attributes>
+struct VertexLayout {
+    static constexpr uint32_t attributeCount = sizeof...(Attributes);
+    static constexpr std::array<uint32_t, attributeCount> offsets = [] {
+        std::array<uint32_t, attributeCount> result {};
+        uint32_t sizes[] = { Attributes::format::size... };
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < attributeCount; i++) {
+            result[i] = offset;
+            offset += sizes[i];
+        }
+        return result;
+    }();
+    static constexpr uint32_t stride = (Attributes::format::size + ...);
+
+    static constexpr VkVertexInputBindingDescription bindingDescription(uint32_t binding, VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX)
+    {
+        return { binding, stride, inputRate };
+    }
+
+    static constexpr std::array<VkVertexInputAttributeDescription, attributeCount> attributeDescriptions(uint32_t binding)
+    {
+        std::array<VkVertexInputAttributeDescription, attributeCount> result {};
+        uint32_t locations[] = { Attributes::location... };
+        VkFormat formats[] = { Attributes::format::format... };
+        for (uint32_t i = 0; i < attributeCount; i++)
+            result[i] = { locations[i], binding, formats[i], offsets[i] };
+        return result;
+    }
+
+    // Encodes one vertex at `out`, which must have room for `stride` bytes.
+    static void write(void* out, const typename Attributes::format::Value&... values)
+    {
+        auto* bytes = static_cast<uint8_t*>(out);
+        uint32_t i = 0;
+        (Attributes::format::encode(values, bytes + offsets[i++]), ...);
+    }
+};
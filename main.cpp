@@ -1,6 +1,9 @@
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <csignal>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -8,18 +11,43 @@
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/trigonometric.hpp>
+#include <iomanip>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <optional>
 #include <set>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan_core.h>
 
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "Benchmarks.hpp"
+#include "Bvh.hpp"
+#include "DeletionQueue.hpp"
+#include "DescriptorAllocator.hpp"
+#include "DescriptorHeap.hpp"
+#include "FrameProfiler.hpp"
+#include "FrustumCulling.hpp"
+#include "JobSystem.hpp"
+#include "MemoryAllocator.hpp"
+#include "MeshFile.hpp"
+#include "ParticleSystem.hpp"
+#include "PipelineCache.hpp"
+#include "RenderGraph.hpp"
+#include "RenderQueue.hpp"
+#include "Scene.hpp"
+#include "ShaderModule.hpp"
+#include "Timeline.hpp"
+#include "UniformRing.hpp"
+#include "UploadManager.hpp"
+#include "VertexLayout.hpp"
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/mat4x4.hpp>
@@ -28,6 +56,11 @@
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Prefers a transfer-only family (a DMA engine); falls back to graphics.
+    std::optional<uint32_t> transferFamily;
+    // Prefers a compute family without graphics, so compute work runs
+    // alongside the render pass; falls back to graphics.
+    std::optional<uint32_t> computeFamily;
 
     bool isComplete() const
     {
@@ -41,32 +74,86 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// Full-precision vertex, as the built-in quad and mesh files store it.
 struct Vertex {
-    glm::vec2 pos;
+    glm::vec3 pos;
     glm::vec3 color;
+};
 
-    static VkVertexInputBindingDescription getBindingDescription()
-    {
-        VkVertexInputBindingDescription bindingDescription {};
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Vertex);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return bindingDescription;
-    }
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptios()
-    {
-        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions {};
-        attributeDescriptions[0].binding = 0;
-        attributeDescriptions[0].location = 0;
-        attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-        attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-        attributeDescriptions[1].binding = 0;
-        attributeDescriptions[1].location = 1;
-        attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescriptions[1].offset = offsetof(Vertex, color);
-        return attributeDescriptions;
+using FloatVertexLayout = VertexLayout<VertexAttribute<0, Float3Format>, VertexAttribute<1, Float3Format>>;
+// --packed-vertices: half-float positions and 8-bit colors, 12 bytes a
+// vertex instead of 24. The shaders read both layouts unchanged.
+using PackedVertexLayout = VertexLayout<VertexAttribute<0, Half4Format>, VertexAttribute<1, Unorm8x4Format>>;
+
+static_assert(FloatVertexLayout::stride == sizeof(Vertex) && sizeof(Vertex) == sizeof(MeshVertex)
+    && offsetof(Vertex, pos) == offsetof(MeshVertex, position) && offsetof(Vertex, color) == offsetof(MeshVertex, color));
+
+// Per-instance stream of the instanced path, bound at binding 1. The matrix
+// takes four consecutive locations, one per column.
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+using InstanceLayout = VertexLayout<VertexAttribute<2, Float4Format>, VertexAttribute<3, Float4Format>, VertexAttribute<4, Float4Format>,
+    VertexAttribute<5, Float4Format>, VertexAttribute<6, Float4Format>>;
+static_assert(InstanceLayout::stride == sizeof(InstanceData) && InstanceLayout::offsets[4] == offsetof(InstanceData, color));
+
+// Object record read by the culling compute pass (shaders/cull.comp).
+struct GpuObject {
+    glm::vec4 positionScale;
+    glm::vec4 colorSpin;
+};
+
+// Push constants of the culling pass; layout matches CullParams in
+// shaders/cull.comp.
+struct CullParams {
+    std::array<glm::vec4, 6> planes;
+    float time;
+    uint32_t objectCount;
+    float boundingRadius;
+};
+
+// How the scene is submitted: one draw per object, one instanced draw fed by
+// the CPU, one indirect instanced draw filled in by a culling compute pass,
+// or one draw per object from a sorted render queue with its MVP in push
+// constants.
+enum class DrawPath {
+    PerDraw,
+    Instanced,
+    GpuDriven,
+    PushConstants,
+};
+
+const char* drawPathName(DrawPath path)
+{
+    switch (path) {
+    case DrawPath::PerDraw:
+        return "per_draw";
+    case DrawPath::Instanced:
+        return "instanced";
+    case DrawPath::GpuDriven:
+        return "gpu_driven";
+    case DrawPath::PushConstants:
+        return "push_constants";
     }
+    return "unknown";
+}
+
+// Material record in the heap's material buffer; layout matches Material in
+// shaders/material.frag.
+struct MaterialData {
+    glm::vec4 tint;
+    DescriptorIndex texture;
+    DescriptorIndex sampler;
+    uint32_t pad[2];
+};
+
+// Per-draw push constant of the material pipeline: where the material
+// records are in the heap and which one to use.
+struct MaterialPush {
+    DescriptorIndex materialBuffer;
+    uint32_t material;
 };
 
 struct UniformBufferObject {
@@ -77,42 +164,224 @@ struct UniformBufferObject {
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
-const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+const uint32_t BENCH_WARMUP_FRAMES = 30;
+const VkDeviceSize UNIFORM_RING_MIN_SIZE = 64 * 1024;
+// Beyond this the per-draw path mostly measures how long it takes to fill a
+// multi-hundred-megabyte uniform ring.
+const uint32_t INSTANCING_BENCH_PER_DRAW_LIMIT = 100000;
+const uint32_t INSTANCING_BENCH_MAX_OBJECTS = 1000000;
+// Objects the CPU culling kernel tests per call, bounding the survivors a job
+// keeps on its stack.
+const uint32_t CULL_BATCH = 256;
+// Fixed so that runs with and without async compute simulate the same thing.
+const float PARTICLE_TIME_STEP = 1.0f / 60.0f;
+const uint32_t MATERIAL_TEXTURE_SIZE = 64;
+// Materials beyond this many share textures.
+const uint32_t MAX_MATERIAL_TEXTURES = 64;
+const VkClearColorValue CLEAR_COLOR = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+// Reverse-Z: the far plane is at depth 0 and nearer is greater.
+const VkClearDepthStencilValue CLEAR_DEPTH = { 0.0f, 0 };
+
+// Headless mode renders into a ring of offscreen images instead of a
+// swapchain, so neither GLFW nor a surface is ever created.
+bool headless = false;
+uint64_t frameLimit = 0;
+volatile std::sig_atomic_t quitRequested = 0;
+
+// --bench <frames>: time the CPU phases of drawFrame and the GPU render pass,
+// then report percentiles after the run.
+uint64_t benchFrames = 0;
+std::string benchJsonPath;
+FrameProfiler profiler;
+uint64_t allocBenchIterations = 0;
+uint64_t syncBenchIterations = 0;
+uint32_t transformBenchNodes = 0;
+uint32_t cullBenchObjects = 0;
+uint32_t bvhBenchObjects = 0;
+uint32_t objectCount = 1;
+DrawPath drawPath = DrawPath::PerDraw;
+uint64_t instancingBenchFrames = 0;
+std::string pipelineCachePath = "pipeline_cache.bin";
+// Recording is split into recordJobCount secondary command buffers; 0 records
+// everything inline on the main thread.
+uint32_t recordJobCount = 0;
+std::optional<uint32_t> jobThreadCount;
+uint32_t jobBenchObjects = 0;
+// --particles <n>: simulate n particles on the compute queue and draw them
+// over the scene.
+uint32_t particleCount = 0;
+bool asyncComputeAllowed = true;
+// --mesh <path>: a mesh-converter file drawn in place of the quad.
+std::string meshPath;
+bool packedVertices = false;
+// Dynamic rendering is used whenever the device has it, unless
+// --no-dynamic-rendering asks for the render pass path.
+bool dynamicRenderingAllowed = true;
+// --dump-graph: print the first frame's compiled render graph.
+bool dumpGraph = false;
+// Presentation and pacing. Without a requested present mode MAILBOX is
+// preferred; without a requested image count one more than the minimum.
+std::optional<VkPresentModeKHR> requestedPresentMode;
+std::optional<uint32_t> requestedSwapchainImages;
+uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+// --target-fps <n>: sleep so frames start at most n times a second.
+double targetFps = 0.0;
+// --max-queued-frames <n>: a frame starts only once the one n frames before
+// it has been presented (VK_KHR_present_wait) or, failing that, rendered.
+uint32_t maxQueuedFrames = 0;
+// --late-latch: sample the camera again right before submit and rewrite it.
+bool lateLatch = false;
+// --depth-prepass: lay down depth with vertex-only pipelines first, so the
+// scene pass shades each pixel once.
+bool depthPrepass = false;
+// --materials <n>: give the per-draw path n materials, each drawn from the
+// bindless descriptor heap by index.
+uint32_t materialCount = 0;
+std::unique_ptr<JobSystem> jobs;
 
 GLFWwindow* window;
 VkInstance instance;
 VkDebugUtilsMessengerEXT debugMessenger;
 VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 VkDevice device;
+MemoryAllocator allocator;
+PipelineCache pipelineCache;
 VkSurfaceKHR surface;
 VkQueue graphicsQueue;
 VkQueue presentQueue;
-VkSwapchainKHR swapChain;
+VkQueue transferQueue;
+VkQueue computeQueue;
+QueueFamilyIndices deviceQueueFamilies;
+UploadManager uploads;
+ParticleSystem particles;
+// The particle step the next frame draws; the compute queue runs one ahead.
+uint64_t simulationStep = 0;
+VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 std::vector<VkImage> swapchainImages;
 VkFormat swapchainImageFormat;
 VkExtent2D swapchainExtent;
 std::vector<VkImageView> swapchainImageViews;
+VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+std::vector<Allocation> offscreenImagesMemory;
 VkRenderPass renderPass;
+// Depth only, for the prepass pipelines; null with dynamic rendering too.
+VkRenderPass prepassRenderPass = VK_NULL_HANDLE;
+VkFormat depthFormat = VK_FORMAT_UNDEFINED;
 VkDescriptorSetLayout descriptorSetLayout;
 VkPipelineLayout pipelineLayout;
 VkPipeline graphicsPipeline;
-std::vector<VkFramebuffer> swapchainFrameBuffers;
+VkPipeline instancedPipeline = VK_NULL_HANDLE;
+VkPipelineLayout pushPipelineLayout = VK_NULL_HANDLE;
+VkPipeline pushPipeline = VK_NULL_HANDLE;
+// Depth-only variants of the pipelines above (and materialPipeline) for
+// --depth-prepass, indexed like them.
+VkPipeline prepassPipeline = VK_NULL_HANDLE;
+VkPipeline prepassInstancedPipeline = VK_NULL_HANDLE;
+VkPipeline prepassPushPipeline = VK_NULL_HANDLE;
+VkPipeline prepassMaterialPipeline = VK_NULL_HANDLE;
+std::vector<VkPipeline> prepassQueuePipelines;
+RenderGraph renderGraph;
 VkCommandPool commandPool;
 std::vector<VkCommandBuffer> commandBuffers;
+// Indexed [frame][record job]. A pool is only ever used by the one job that
+// records into it, whichever thread that job lands on.
+std::vector<std::vector<VkCommandPool>> recordCommandPools;
+std::vector<std::vector<VkCommandBuffer>> recordCommandBuffers;
 std::vector<VkSemaphore> imageAvailableSemaphores;
 std::vector<VkSemaphore> renderFinishedSemaphores;
-std::vector<VkFence> inFlightFences;
 bool framebufferResized = false;
 uint32_t currentFrame = 0;
+// Frames are numbered from 1 as they are recorded, and each frame's
+// submission signals its number on the graphics timeline. Each slot
+// remembers the number of the frame it last submitted.
+Timeline graphicsTimeline;
+uint64_t frameNumber = 0;
+std::vector<uint64_t> slotFrameNumbers;
+DeletionQueue deletionQueue;
 VkBuffer vertexBuffer;
-VkDeviceMemory vertexBufferMemory;
+Allocation vertexBufferMemory;
 VkBuffer indexBuffer;
-VkDeviceMemory indexBufferMemory;
-std::vector<VkBuffer> uniformBuffers;
-std::vector<VkDeviceMemory> uniformBuffersMemory;
-std::vector<void*> uniformBuffersMapped;
-VkDescriptorPool descriptorPool;
+Allocation indexBufferMemory;
+// What every object draws: the built-in quad or the --mesh file.
+uint32_t meshIndexCount = 0;
+VkIndexType meshIndexType = VK_INDEX_TYPE_UINT16;
+float meshBoundingRadius = QUAD_BOUNDING_RADIUS;
+MappedMesh meshFile;
+std::vector<UniformRing> uniformRings;
+std::vector<uint32_t> objectUniformOffsets;
+// Bounding spheres of sceneObjects for the CPU culling kernel, and the
+// per-draw path's survivors in the order the jobs found them.
+BoundingSpheres objectSpheres;
+SimdLevel cullSimdLevel = detectSimdLevel();
+std::vector<uint32_t> visibleObjects;
+uint32_t visibleObjectCount = 0;
+// With --bvh, the CPU paths cull only the objects the hierarchy's frustum
+// query returns (by box, so a few more than the spheres would keep) instead
+// of testing every sphere.
+bool useBvh = false;
+Bvh objectBvh;
+std::vector<uint32_t> bvhCandidates;
+// The push constant path: visible objects as draw items, and the MVP each
+// one pushes. Key fields index queuePipelines and, for the mesh, the one
+// mesh there is; the descriptor set field stays 0, as no sets are bound.
+RenderQueue renderQueue;
+std::vector<glm::mat4> objectMvps;
+std::vector<VkPipeline> queuePipelines;
+std::vector<VkBuffer> instanceBuffers;
+std::vector<Allocation> instanceBuffersMemory;
+uint32_t instanceCount = 0;
+// The camera block of the frame's ring, for the instanced draws and the
+// particles.
+uint32_t cameraUniformOffset = 0;
+VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;
+VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+VkPipeline cullPipeline = VK_NULL_HANDLE;
+std::vector<VkDescriptorSet> cullDescriptorSets;
+VkBuffer objectBuffer = VK_NULL_HANDLE;
+Allocation objectBufferMemory;
+// One VkDrawIndexedIndirectCommand per mesh, whose instance count the
+// culling pass accumulates.
+std::vector<VkBuffer> drawCommandBuffers;
+std::vector<Allocation> drawCommandBuffersMemory;
+CullParams cullParams {};
+glm::mat4 cameraViewProj { 1.0f };
+// Highest version both the loader and this program know; devices may be lower.
+uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+// Set when passes render without VkRenderPass and VkFramebuffer objects.
+PFN_vkCmdBeginRendering cmdBeginRendering = nullptr;
+PFN_vkCmdEndRendering cmdEndRendering = nullptr;
+// Set when --max-queued-frames can wait for presentation itself. Present ids
+// count up per swapchain, starting over when it is recreated.
+PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+uint64_t presentId = 0;
+std::chrono::steady_clock::time_point nextFrameDeadline;
+// Where updateUniformBuffer left the camera this frame, for late latching:
+// the shared camera block (instanced paths and particles) and/or one block
+// per visible object.
+UniformBufferObject* latchedCameraBlock = nullptr;
+uint8_t* latchedObjectBlocks = nullptr;
+VkDeviceSize latchedObjectStride = 0;
+std::chrono::steady_clock::time_point cameraSampleTime;
+std::vector<SceneObject> sceneObjects;
+DescriptorAllocator descriptorAllocator;
 std::vector<VkDescriptorSet> descriptorSets;
+// Only created for --materials, on devices with descriptor indexing.
+DescriptorHeap descriptorHeap;
+VkPipelineLayout materialPipelineLayout = VK_NULL_HANDLE;
+VkPipeline materialPipeline = VK_NULL_HANDLE;
+std::vector<VkImage> materialImages;
+std::vector<Allocation> materialImagesMemory;
+std::vector<VkImageView> materialImageViews;
+std::array<VkSampler, 2> materialSamplers {};
+VkBuffer materialBuffer = VK_NULL_HANDLE;
+Allocation materialBufferMemory;
+DescriptorIndex materialBufferIndex = 0;
+VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+float timestampPeriod = 1.0f;
+uint64_t timestampMask = 0;
+std::vector<bool> timestampsWritten;
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -123,14 +392,14 @@ const bool enableValidationLayers = true;
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation",
 };
-const std::vector<const char*> deviceExtensions = {
+const std::vector<const char*> swapchainDeviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 const std::vector<Vertex> vertices = {
-    { { -0.5f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
-    { { 0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f } },
-    { { 0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } },
-    { { -0.5f, 0.5f }, { 1.0f, 1.0f, 1.0f } },
+    { { -0.5f, -0.5f, 0.0f }, { 1.0f, 0.0f, 0.0f } },
+    { { 0.5f, -0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+    { { 0.5f, 0.5f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+    { { -0.5f, 0.5f, 0.0f }, { 1.0f, 1.0f, 1.0f } },
 };
 const std::vector<uint16_t> indices = {
     0, 1, 2, 2, 3, 0
@@ -149,18 +418,9 @@ void framebufferResizeCallback(GLFWwindow* w, int width, int height)
     framebufferResized = true;
 }
 
-std::vector<char> readFile(const std::string& filename)
+void signalHandler(int)
 {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file!");
-    }
-    const auto fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
+    quitRequested = 1;
 }
 
 void initWindow()
@@ -196,11 +456,12 @@ bool checkValidationLayerSupport()
 
 std::vector<const char*> getRequiredExtensions()
 {
-    uint32_t glfwExtensionsCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
-
-    std::vector<const char*> extensions(glfwExtensions,
-        glfwExtensions + glfwExtensionsCount);
+    std::vector<const char*> extensions;
+    if (!headless) {
+        uint32_t glfwExtensionsCount = 0;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionsCount);
+    }
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
     }
@@ -275,7 +536,14 @@ void createInstance()
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    // A 1.0 loader fails instance creation for any newer version, so ask
+    // for what it reports; 1.3 is enough for dynamic rendering in core.
+    auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+        vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+    if (enumerateInstanceVersion && enumerateInstanceVersion(&instanceApiVersion) != VK_SUCCESS)
+        instanceApiVersion = VK_API_VERSION_1_0;
+    instanceApiVersion = std::min(instanceApiVersion, static_cast<uint32_t>(VK_API_VERSION_1_3));
+    appInfo.apiVersion = instanceApiVersion;
 
     VkInstanceCreateInfo createInfo {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -314,17 +582,41 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device)
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-        if (presentSupport)
-            indices.presentFamily = i;
+        if (!headless) {
+            VkBool32 presentSupport = false;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (presentSupport)
+                indices.presentFamily = i;
+        }
         if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
             indices.graphicsFamily = i;
-        if (indices.isComplete())
+        if (indices.isComplete() || (headless && indices.graphicsFamily.has_value()))
             break;
         i++;
     }
 
+    for (uint32_t j = 0; j < queueFamilyCount; j++) {
+        auto flags = queueFamilies[j].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            indices.transferFamily = j;
+            break;
+        }
+    }
+    if (!indices.transferFamily.has_value())
+        indices.transferFamily = indices.graphicsFamily;
+
+    if (asyncComputeAllowed) {
+        for (uint32_t j = 0; j < queueFamilyCount; j++) {
+            auto flags = queueFamilies[j].queueFlags;
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.computeFamily = j;
+                break;
+            }
+        }
+    }
+    if (!indices.computeFamily.has_value())
+        indices.computeFamily = indices.graphicsFamily;
+
     return indices;
 }
 
@@ -352,6 +644,23 @@ SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice vkDevice)
     return details;
 }
 
+std::vector<const char*> getRequiredDeviceExtensions()
+{
+    if (headless)
+        return {};
+    return swapchainDeviceExtensions;
+}
+
+bool isDeviceExtensionAvailable(VkPhysicalDevice vkDevice, const char* name)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(vkDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(vkDevice, nullptr, &extensionCount, availableExtensions.data());
+    return std::any_of(availableExtensions.begin(), availableExtensions.end(),
+        [name](const VkExtensionProperties& extension) { return std::strcmp(extension.extensionName, name) == 0; });
+}
+
 bool checkDeviceExtensionSupport(VkPhysicalDevice vkDevice)
 {
     uint32_t extensionCount;
@@ -360,6 +669,7 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice vkDevice)
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(vkDevice, nullptr, &extensionCount,
         availableExtensions.data());
+    const auto deviceExtensions = getRequiredDeviceExtensions();
     std::set<std::string> requiredExtensions(deviceExtensions.begin(),
         deviceExtensions.end());
     for (const auto& extension : availableExtensions)
@@ -367,9 +677,36 @@ bool checkDeviceExtensionSupport(VkPhysicalDevice vkDevice)
     return requiredExtensions.empty();
 }
 
+const std::array<std::pair<const char*, VkPresentModeKHR>, 4> PRESENT_MODE_NAMES { {
+    { "fifo", VK_PRESENT_MODE_FIFO_KHR },
+    { "fifo-relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR },
+    { "mailbox", VK_PRESENT_MODE_MAILBOX_KHR },
+    { "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR },
+} };
+
+const char* presentModeName(VkPresentModeKHR presentMode)
+{
+    for (const auto& [name, mode] : PRESENT_MODE_NAMES) {
+        if (mode == presentMode)
+            return name;
+    }
+    return "unknown";
+}
+
 VkPresentModeKHR chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
+    // FIFO is the only mode every surface supports.
+    if (requestedPresentMode) {
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), *requestedPresentMode) != availablePresentModes.end())
+            return *requestedPresentMode;
+        static bool warned = false;
+        if (!warned) {
+            std::cerr << "warning: present mode " << presentModeName(*requestedPresentMode) << " is not supported, using fifo\n";
+            warned = true;
+        }
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
     for (const auto& availablePresentMode : availablePresentModes) {
         if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
             return availablePresentMode;
@@ -411,14 +748,24 @@ bool isDeviceSuitable(VkPhysicalDevice device)
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
     vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
+    // Frame, upload and particle synchronization is built on timeline
+    // semaphores, which are core (and mandatory) from Vulkan 1.2 on.
+    if (std::min(instanceApiVersion, deviceProperties.apiVersion) < VK_API_VERSION_1_2)
+        return false;
     bool extensionsSupported = checkDeviceExtensionSupport(device);
+    QueueFamilyIndices indices = findQueueFamilies(device);
+    if (headless) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device, OFFSCREEN_FORMAT, &formatProperties);
+        bool renderable = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+        return indices.graphicsFamily.has_value() && extensionsSupported && renderable;
+    }
+
     bool swapChainAdequate = false;
     if (extensionsSupported) {
         auto swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
-
-    QueueFamilyIndices indices = findQueueFamilies(device);
     return indices.isComplete() && extensionsSupported && swapChainAdequate;
 }
 
@@ -447,9 +794,11 @@ void pickPhysicalDevice()
 void createLogicalDevice()
 {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+    deviceQueueFamilies = indices;
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(),
-        indices.presentFamily.value() };
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.transferFamily.value(), indices.computeFamily.value() };
+    if (!headless)
+        uniqueQueueFamilies.insert(indices.presentFamily.value());
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
         VkDeviceQueueCreateInfo queueCreateInfo {};
@@ -460,6 +809,83 @@ void createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
     VkPhysicalDeviceFeatures deviceFeatures {};
+    auto deviceExtensions = getRequiredDeviceExtensions();
+
+    // Dynamic rendering is core in 1.3. On 1.2 the extension's own
+    // dependencies (create_renderpass2, depth_stencil_resolve) are core, so it
+    // can be enabled alone; older devices keep render passes.
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    uint32_t apiVersion = std::min(instanceApiVersion, deviceProperties.apiVersion);
+    bool coreDynamicRendering = apiVersion >= VK_API_VERSION_1_3;
+    bool extensionDynamicRendering = !coreDynamicRendering && apiVersion >= VK_API_VERSION_1_2
+        && isDeviceExtensionAvailable(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    bool queryDynamicRendering = dynamicRenderingAllowed && (coreDynamicRendering || extensionDynamicRendering);
+    // Present wait only serves --max-queued-frames, which otherwise waits for
+    // rendering rather than presentation.
+    bool queryPresentWait = !headless && maxQueuedFrames > 0
+        && isDeviceExtensionAvailable(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+        && isDeviceExtensionAvailable(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures {};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures {};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures {};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    // Descriptor indexing is core in 1.2 but optional; only --materials uses it.
+    bool queryDescriptorIndexing = materialCount > 0;
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures {};
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    if (queryDynamicRendering || queryPresentWait || queryDescriptorIndexing) {
+        VkPhysicalDeviceFeatures2 features {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        if (queryDynamicRendering) {
+            dynamicRenderingFeatures.pNext = features.pNext;
+            features.pNext = &dynamicRenderingFeatures;
+        }
+        if (queryPresentWait) {
+            presentWaitFeatures.pNext = features.pNext;
+            presentIdFeatures.pNext = &presentWaitFeatures;
+            features.pNext = &presentIdFeatures;
+        }
+        if (queryDescriptorIndexing) {
+            descriptorIndexingFeatures.pNext = features.pNext;
+            features.pNext = &descriptorIndexingFeatures;
+        }
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+    }
+    bool dynamicRendering = dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+    if (dynamicRendering && extensionDynamicRendering)
+        deviceExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    bool presentWait = presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+    if (presentWait) {
+        deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+    bool descriptorIndexing = queryDescriptorIndexing && DescriptorHeap::isSupported(descriptorIndexingFeatures);
+    if (queryDescriptorIndexing && !descriptorIndexing) {
+        std::cerr << "warning: descriptor indexing is not supported, drawing without materials\n";
+        materialCount = 0;
+    }
+    // The same structs enable what was found, chained again without the
+    // features that turned out unsupported.
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures {};
+    timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    void* enabledFeatures = &timelineSemaphoreFeatures;
+    if (dynamicRendering) {
+        dynamicRenderingFeatures.pNext = enabledFeatures;
+        enabledFeatures = &dynamicRenderingFeatures;
+    }
+    if (presentWait) {
+        presentWaitFeatures.pNext = enabledFeatures;
+        presentIdFeatures.pNext = &presentWaitFeatures;
+        enabledFeatures = &presentIdFeatures;
+    }
+    if (descriptorIndexing) {
+        descriptorIndexingFeatures.pNext = enabledFeatures;
+        enabledFeatures = &descriptorIndexingFeatures;
+    }
 
     VkDeviceCreateInfo createInfo {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -468,11 +894,23 @@ void createLogicalDevice()
     createInfo.pEnabledFeatures = &deviceFeatures;
     createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.pNext = enabledFeatures;
 
     if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
         throw std::runtime_error("failed to create logical device!");
+    if (dynamicRendering) {
+        cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(
+            vkGetDeviceProcAddr(device, coreDynamicRendering ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR"));
+        cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRendering>(
+            vkGetDeviceProcAddr(device, coreDynamicRendering ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR"));
+    }
+    if (presentWait)
+        waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-    vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+    vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+    if (!headless)
+        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 }
 
 void createSurface()
@@ -488,10 +926,12 @@ void createSwapChain()
     auto surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
     auto presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     auto extent = chooseSwapExtent(swapChainSupport.capabilities);
-    auto imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    auto imageCount = requestedSwapchainImages.value_or(swapChainSupport.capabilities.minImageCount + 1);
+    imageCount = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
+    swapchainPresentMode = presentMode;
     VkSwapchainCreateInfoKHR createInfo {};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     createInfo.surface = surface;
@@ -517,7 +957,9 @@ void createSwapChain()
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // Lets the driver hand resources over from the swapchain being replaced;
+    // images already acquired from it stay presentable.
+    createInfo.oldSwapchain = swapChain;
 
     if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swapchain!");
@@ -558,25 +1000,10 @@ void createImageViews()
     }
 }
 
-VkShaderModule createShaderModule(const std::vector<char>& code)
-{
-    VkShaderModuleCreateInfo createInfo {};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create shader module!");
-    }
-    return shaderModule;
-}
-
 void createGraphicsPipeline()
 {
-    auto vertShaderCode = readFile("shaders/vert.spv");
-    auto fragShaderCode = readFile("shaders/frag.spv");
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    VkShaderModule vertShaderModule = loadShaderModule(device, "shaders/vert.spv");
+    VkShaderModule fragShaderModule = loadShaderModule(device, "shaders/frag.spv");
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo {};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -608,8 +1035,8 @@ void createGraphicsPipeline()
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptios();
+    auto bindingDescription = packedVertices ? PackedVertexLayout::bindingDescription(0) : FloatVertexLayout::bindingDescription(0);
+    auto attributeDescriptions = packedVertices ? PackedVertexLayout::attributeDescriptions(0) : FloatVertexLayout::attributeDescriptions(0);
     vertexInputInfo.vertexBindingDescriptionCount = 1;
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
@@ -652,6 +1079,16 @@ void createGraphicsPipeline()
     rasterizer.depthBiasClamp = 0.0f;
     rasterizer.depthBiasSlopeFactor = 0.0f;
 
+    // Reverse-Z, so nearer passes as greater. After a prepass the depth is
+    // already final and the scene pass only tests against it.
+    VkPipelineDepthStencilStateCreateInfo depthStencil {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = depthPrepass ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = depthPrepass ? VK_COMPARE_OP_GREATER_OR_EQUAL : VK_COMPARE_OP_GREATER;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
     VkPipelineMultisampleStateCreateInfo multisampling {};
     multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
     multisampling.sampleShadingEnable = VK_FALSE;
@@ -684,8 +1121,8 @@ void createGraphicsPipeline()
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 0;
-    pipelineLayoutInfo.pSetLayouts = nullptr;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
     pipelineLayoutInfo.pushConstantRangeCount = 0;
     pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
@@ -702,24 +1139,206 @@ void createGraphicsPipeline()
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr;
+    pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = pipelineLayout;
     pipelineInfo.renderPass = renderPass;
     pipelineInfo.subpass = 0;
+    VkPipelineRenderingCreateInfo renderingInfo {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &swapchainImageFormat;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+    if (renderPass == VK_NULL_HANDLE)
+        pipelineInfo.pNext = &renderingInfo;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex = -1;
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
 
+    // The prepass variant of whatever pipelineInfo describes at the time:
+    // its vertex stage alone (always the first), writing depth and no color.
+    // It runs the same vertex shader as the scene pass, so both compute the
+    // same depths and the scene pass's GREATER_OR_EQUAL test keeps exactly
+    // the nearest surface.
+    VkPipelineDepthStencilStateCreateInfo prepassDepthStencil = depthStencil;
+    prepassDepthStencil.depthWriteEnable = VK_TRUE;
+    prepassDepthStencil.depthCompareOp = VK_COMPARE_OP_GREATER;
+    VkPipelineColorBlendStateCreateInfo prepassBlending = colorBlending;
+    prepassBlending.attachmentCount = 0;
+    VkPipelineRenderingCreateInfo prepassRenderingInfo = renderingInfo;
+    prepassRenderingInfo.colorAttachmentCount = 0;
+    prepassRenderingInfo.pColorAttachmentFormats = nullptr;
+    auto createPrepassVariant = [&](VkPipeline& pipeline) {
+        if (!depthPrepass)
+            return;
+        VkGraphicsPipelineCreateInfo prepassInfo = pipelineInfo;
+        prepassInfo.stageCount = 1;
+        prepassInfo.pDepthStencilState = &prepassDepthStencil;
+        prepassInfo.pColorBlendState = &prepassBlending;
+        prepassInfo.renderPass = prepassRenderPass;
+        prepassInfo.pNext = prepassRenderPass == VK_NULL_HANDLE ? &prepassRenderingInfo : nullptr;
+        if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &prepassInfo, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth prepass pipeline!");
+        }
+    };
+    createPrepassVariant(prepassPipeline);
+
+    // The material variant reads the descriptor heap as set 1 and takes the
+    // material of each draw as a push constant.
+    if (materialCount > 0) {
+        std::array<VkDescriptorSetLayout, 2> setLayouts = { descriptorSetLayout, descriptorHeap.layout() };
+        VkPushConstantRange pushConstantRange {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(MaterialPush);
+        VkPipelineLayoutCreateInfo materialLayoutInfo {};
+        materialLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        materialLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        materialLayoutInfo.pSetLayouts = setLayouts.data();
+        materialLayoutInfo.pushConstantRangeCount = 1;
+        materialLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &materialLayoutInfo, nullptr, &materialPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create material pipeline layout!");
+        }
+
+        VkShaderModule materialVertModule = loadShaderModule(device, "shaders/material_vert.spv");
+        VkShaderModule materialFragModule = loadShaderModule(device, "shaders/material_frag.spv");
+        VkPipelineShaderStageCreateInfo materialStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+        materialStages[0].module = materialVertModule;
+        materialStages[1].module = materialFragModule;
+        pipelineInfo.pStages = materialStages;
+        pipelineInfo.layout = materialPipelineLayout;
+        if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &pipelineInfo, nullptr, &materialPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create material graphics pipeline!");
+        }
+        createPrepassVariant(prepassMaterialPipeline);
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.layout = pipelineLayout;
+        vkDestroyShaderModule(device, materialVertModule, nullptr);
+        vkDestroyShaderModule(device, materialFragModule, nullptr);
+    }
+
+    // The push constant variant takes the whole MVP from the draw and binds
+    // no descriptor sets.
+    if (drawPath == DrawPath::PushConstants || instancingBenchFrames > 0) {
+        VkPushConstantRange pushConstantRange {};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(glm::mat4);
+        VkPipelineLayoutCreateInfo pushLayoutInfo {};
+        pushLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pushLayoutInfo.setLayoutCount = 0;
+        pushLayoutInfo.pushConstantRangeCount = 1;
+        pushLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pushLayoutInfo, nullptr, &pushPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create push constant pipeline layout!");
+        }
+
+        VkShaderModule pushVertModule = loadShaderModule(device, "shaders/push_vert.spv");
+        VkPipelineShaderStageCreateInfo pushStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+        pushStages[0].module = pushVertModule;
+        pipelineInfo.pStages = pushStages;
+        pipelineInfo.layout = pushPipelineLayout;
+        if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &pipelineInfo, nullptr, &pushPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create push constant graphics pipeline!");
+        }
+        createPrepassVariant(prepassPushPipeline);
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.layout = pipelineLayout;
+        vkDestroyShaderModule(device, pushVertModule, nullptr);
+        queuePipelines = { pushPipeline };
+        prepassQueuePipelines = { prepassPushPipeline };
+    }
+
+    // The instanced variant only swaps the vertex shader and adds the
+    // per-instance stream.
+    if (drawPath == DrawPath::Instanced || drawPath == DrawPath::GpuDriven || instancingBenchFrames > 0) {
+        VkShaderModule instancedShaderModule = loadShaderModule(device, "shaders/instanced_vert.spv");
+        shaderStages[0].module = instancedShaderModule;
+
+        std::array<VkVertexInputBindingDescription, 2> bindings = { bindingDescription, InstanceLayout::bindingDescription(1, VK_VERTEX_INPUT_RATE_INSTANCE) };
+        std::vector<VkVertexInputAttributeDescription> attributes(attributeDescriptions.begin(), attributeDescriptions.end());
+        auto instanceAttributes = InstanceLayout::attributeDescriptions(1);
+        attributes.insert(attributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindings.size());
+        vertexInputInfo.pVertexBindingDescriptions = bindings.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+        vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
+        if (vkCreateGraphicsPipelines(device, pipelineCache.handle(), 1, &pipelineInfo, nullptr, &instancedPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create instanced graphics pipeline!");
+        }
+        createPrepassVariant(prepassInstancedPipeline);
+        vkDestroyShaderModule(device, instancedShaderModule, nullptr);
+    }
+
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
 }
 
+void createCullPipeline()
+{
+    if (drawPath != DrawPath::GpuDriven && instancingBenchFrames == 0)
+        return;
+    VkShaderModule cullShaderModule = loadShaderModule(device, "shaders/cull_comp.spv");
+
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullParams);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline layout!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = cullShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+    if (vkCreateComputePipelines(device, pipelineCache.handle(), 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline!");
+    }
+    vkDestroyShaderModule(device, cullShaderModule, nullptr);
+}
+
+// Reverse-Z wants a float depth buffer: near the far plane a 24-bit unorm
+// one runs out of distinct values long before a float does. D24 is only the
+// last resort.
+VkFormat findDepthFormat()
+{
+    for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT }) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            return format;
+    }
+    throw std::runtime_error("failed to find a depth attachment format!");
+}
+
+// Pipelines are created against this render pass (color and depth) and the
+// prepass ones against a depth-only one; frames are recorded in the
+// compatible ones the render graph begins (same attachment formats). With
+// dynamic rendering pipelines name the formats themselves and no render
+// pass exists.
 void createRenderPass()
 {
+    depthFormat = findDepthFormat();
+    if (cmdBeginRendering) {
+        renderPass = VK_NULL_HANDLE;
+        return;
+    }
+
     VkAttachmentDescription colorAttachment {};
     colorAttachment.format = swapchainImageFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -727,56 +1346,53 @@ void createRenderPass()
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription depthAttachment {};
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef {};
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkAttachmentReference depthAttachmentRef {};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkSubpassDescription subpass {};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-    VkSubpassDependency dependecy {};
-    dependecy.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependecy.dstSubpass = 0;
-    dependecy.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependecy.srcAccessMask = 0;
-    dependecy.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependecy.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
+    std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
     VkRenderPassCreateInfo renderPassInfo {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependecy;
     if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass");
     }
-}
 
-void createFramebuffers()
-{
-    swapchainFrameBuffers.resize(swapchainImageViews.size());
-    for (size_t i = 0; i < swapchainImageViews.size(); i++) {
-        VkImageView attachments[] = {
-            swapchainImageViews[i],
-        };
-        VkFramebufferCreateInfo framebufferInfo {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = swapchainExtent.width;
-        framebufferInfo.height = swapchainExtent.height;
-        framebufferInfo.layers = 1;
-        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapchainFrameBuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create framebuffer!");
+    if (depthPrepass) {
+        depthAttachmentRef.attachment = 0;
+        VkSubpassDescription prepassSubpass {};
+        prepassSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        prepassSubpass.pDepthStencilAttachment = &depthAttachmentRef;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depthAttachment;
+        renderPassInfo.pSubpasses = &prepassSubpass;
+        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &prepassRenderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth prepass render pass");
         }
     }
 }
@@ -795,35 +1411,106 @@ void createCommandPool()
 
 void createCommandBuffer()
 {
-    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    commandBuffers.resize(framesInFlight);
     VkCommandBufferAllocateInfo allocInfo {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = 2;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(framesInFlight);
     if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate command buffers!");
     }
 }
 
+void createRecordCommandPools()
+{
+    if (recordJobCount == 0)
+        return;
+    recordCommandPools.assign(framesInFlight, std::vector<VkCommandPool>(recordJobCount));
+    recordCommandBuffers.assign(framesInFlight, std::vector<VkCommandBuffer>(recordJobCount));
+    for (size_t frame = 0; frame < framesInFlight; frame++) {
+        for (uint32_t job = 0; job < recordJobCount; job++) {
+            VkCommandPoolCreateInfo poolInfo {};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = deviceQueueFamilies.graphicsFamily.value();
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &recordCommandPools[frame][job]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create record command pool!");
+            }
+            VkCommandBufferAllocateInfo allocInfo {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = recordCommandPools[frame][job];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &recordCommandBuffers[frame][job]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate secondary command buffers!");
+            }
+        }
+    }
+}
+
 void createSyncObjects()
 {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    imageAvailableSemaphores.resize(framesInFlight);
+    renderFinishedSemaphores.resize(framesInFlight);
+    slotFrameNumbers.assign(framesInFlight, 0);
+    graphicsTimeline.init(device);
 
+    // The swapchain only takes binary semaphores.
     VkSemaphoreCreateInfo semaphoreInfo {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    VkFenceCreateInfo fenceInfo {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS || vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS || vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+    for (size_t i = 0; i < framesInFlight; i++) {
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS || vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronization objects for frame!");
         }
     }
 }
 
+// Two timestamps per frame in flight bracket the render pass. Left
+// VK_NULL_HANDLE when not benchmarking or when the graphics queue cannot
+// write timestamps.
+void createTimestampQueryPool()
+{
+    if (benchFrames == 0)
+        return;
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = queueFamilies[findQueueFamilies(physicalDevice).graphicsFamily.value()].timestampValidBits;
+    if (validBits == 0 || props.limits.timestampPeriod == 0.0f) {
+        std::cout << "timestamps not supported on the graphics queue, GPU time will not be reported\n";
+        return;
+    }
+    timestampPeriod = props.limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+    timestampsWritten.assign(framesInFlight, false);
+
+    VkQueryPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * framesInFlight;
+    if (vkCreateQueryPool(device, &poolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+}
+
+// Called once the frame has completed on the graphics timeline, so the
+// results are available without VK_QUERY_RESULT_WAIT_BIT.
+void collectGpuTimestamps(uint32_t frame)
+{
+    if (timestampQueryPool == VK_NULL_HANDLE || !timestampsWritten[frame])
+        return;
+    uint64_t timestamps[2] = {};
+    if (vkGetQueryPoolResults(device, timestampQueryPool, frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        uint64_t ticks = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+        profiler.record(FramePhase::GpuRenderPass, static_cast<double>(ticks) * timestampPeriod / 1e6);
+    }
+    timestampsWritten[frame] = false;
+}
+
 uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
     VkPhysicalDeviceMemoryProperties memProperties;
@@ -836,105 +1523,148 @@ uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
-void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& bufferMemory)
 {
     VkBufferCreateInfo bufferInfo {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // Upload destinations are written on the transfer queue and read on the
+    // graphics queue; concurrent sharing avoids ownership transfer barriers.
+    uint32_t families[] = { deviceQueueFamilies.graphicsFamily.value(), deviceQueueFamilies.transferFamily.value() };
+    if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && families[0] != families[1]) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = families;
+    }
     if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create vertex buffer!");
     }
 
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-    VkMemoryAllocateInfo allocInfo {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-    }
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    bufferMemory = allocator.allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, properties), AllocationKind::Linear);
+    vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
-void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void destroyBuffer(VkBuffer buffer, Allocation& bufferMemory)
 {
-    VkCommandBufferAllocateInfo allocInfo {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-    VkCommandBufferBeginInfo beginInfo {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator.free(bufferMemory);
+}
 
-    VkBufferCopy copyRegion {};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, Allocation& imageMemory)
+{
+    VkImageCreateInfo imageInfo {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = tiling;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
 
-    vkEndCommandBuffer(commandBuffer);
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    auto kind = tiling == VK_IMAGE_TILING_OPTIMAL ? AllocationKind::Optimal : AllocationKind::Linear;
+    imageMemory = allocator.allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, properties), kind);
+    vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
+}
 
-    VkSubmitInfo submitInfo {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+// Stand-in for createSwapChain in headless mode: one offscreen color target
+// per frame in flight. drawFrame renders into slot currentFrame, so the
+// timeline wait that guards the command buffer also guards the image.
+void createOffscreenTargets()
+{
+    swapchainImageFormat = OFFSCREEN_FORMAT;
+    swapchainExtent = { WIDTH, HEIGHT };
+    swapchainImages.resize(framesInFlight);
+    offscreenImagesMemory.resize(framesInFlight);
+    for (size_t i = 0; i < framesInFlight; i++) {
+        createImage(swapchainExtent.width, swapchainExtent.height, swapchainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            swapchainImages[i], offscreenImagesMemory[i]);
+    }
+}
 
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+void createUploadManager()
+{
+    uint32_t stagingMemoryType = findMemoryType(~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    uploads.init(device, allocator, stagingMemoryType, deviceQueueFamilies.transferFamily.value(), transferQueue);
+}
 
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+// Maps the --mesh file, if any. Its sections are copied from the mapping
+// straight into staging memory by createVertexBuffer and createIndexBuffer,
+// and the mapping is dropped once they have been enqueued.
+void loadMesh()
+{
+    if (meshPath.empty()) {
+        meshIndexCount = static_cast<uint32_t>(indices.size());
+        return;
+    }
+    meshFile.open(meshPath);
+    const MeshHeader& header = meshFile.header();
+    meshIndexCount = header.indexCount;
+    meshIndexType = header.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    // Objects spin around the mesh origin, so the bounding sphere is centred
+    // there rather than on the box.
+    glm::vec3 extent = glm::max(glm::abs(glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2])),
+        glm::abs(glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2])));
+    meshBoundingRadius = glm::length(extent);
 }
 
 void createVertexBuffer()
 {
+    const void* data = vertices.data();
     VkDeviceSize size = sizeof(vertices[0]) * vertices.size();
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
-    memcpy(data, vertices.data(), static_cast<size_t>(size));
-    vkUnmapMemory(device, stagingBufferMemory);
-
+    if (meshFile.isOpen()) {
+        data = meshFile.vertexData();
+        size = meshFile.vertexDataSize();
+    }
+    // Packing is the one pass over the vertices; the packed stream then
+    // goes to staging like the float one would.
+    std::vector<uint8_t> packed;
+    if (packedVertices) {
+        const auto* source = static_cast<const Vertex*>(data);
+        size_t count = size / sizeof(Vertex);
+        packed.resize(count * PackedVertexLayout::stride);
+        for (size_t i = 0; i < count; i++)
+            PackedVertexLayout::write(&packed[i * PackedVertexLayout::stride], source[i].pos, source[i].color);
+        data = packed.data();
+        size = packed.size();
+        std::cout << "packed vertices: " << count << " x " << PackedVertexLayout::stride << " bytes (" << sizeof(Vertex) << " unpacked)\n";
+    }
     createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-    copyBuffer(stagingBuffer, vertexBuffer, size);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    uploads.enqueue(vertexBuffer, 0, data, size);
 }
 
 void createIndexBuffer()
 {
-    const auto size = sizeof(indices[0]) * indices.size();
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
-    memcpy(data, indices.data(), size);
-    vkUnmapMemory(device, stagingBufferMemory);
-
+    const void* data = indices.data();
+    VkDeviceSize size = sizeof(indices[0]) * indices.size();
+    if (meshFile.isOpen()) {
+        data = meshFile.indexData();
+        size = meshFile.indexDataSize();
+    }
     createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-    copyBuffer(stagingBuffer, indexBuffer, size);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    uploads.enqueue(indexBuffer, 0, data, size);
 }
 
 void createDescriptorSetLayout()
 {
     VkDescriptorSetLayoutBinding uboLayoutBinding {};
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     uboLayoutBinding.pImmutableSamplers = nullptr;
@@ -947,58 +1677,180 @@ void createDescriptorSetLayout()
     if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
+}
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+// Objects in, then per-frame instance data and the draw record out.
+void createCullDescriptorSetLayout()
+{
+    if (drawPath != DrawPath::GpuDriven && instancingBenchFrames == 0)
+        return;
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings {};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull descriptor set layout!");
+    }
 }
 
-void createUniformBuffers()
+// Lays objectCount quads out on a square grid in the z = 0 plane, shrunk to
+// fit the view of the original single quad.
+void createScene()
 {
-    VkDeviceSize size = sizeof(UniformBufferObject);
-    uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        createBuffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
-        vkMapMemory(device, uniformBuffersMemory[i], 0, size, 0, &uniformBuffersMapped[i]);
+    sceneObjects = createGridScene(objectCount);
+    objectSpheres.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++)
+        objectSpheres.set(i, sceneObjects[i].position, meshBoundingRadius * sceneObjects[i].scale);
+    visibleObjects.assign(objectCount, 0);
+    visibleObjectCount = 0;
+    // The grid only spins objects in place, so their bounds never change
+    // and the hierarchy is built once rather than refit per frame.
+    if (useBvh) {
+        std::vector<Aabb> bounds(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++) {
+            glm::vec3 extent(objectSpheres.radius[i]);
+            bounds[i] = { sceneObjects[i].position - extent, sceneObjects[i].position + extent };
+        }
+        objectBvh.build(bounds);
+        bvhCandidates.reserve(objectCount);
     }
+    objectMvps.resize(drawPath == DrawPath::PushConstants ? objectCount : 0);
 }
 
-void createDescriptorPool()
+void createUniformBuffers()
 {
-    VkDescriptorPoolSize poolSize {};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    VkDeviceSize alignment = props.limits.minUniformBufferOffsetAlignment;
+    VkDeviceSize blockSize = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+    // One camera block per frame for the instanced paths and the particles,
+    // plus one block per object on the per-draw path.
+    VkDeviceSize blockCount = 1 + (drawPath == DrawPath::PerDraw ? objectCount : 0);
+    VkDeviceSize size = std::max<VkDeviceSize>(UNIFORM_RING_MIN_SIZE, blockSize * blockCount);
+
+    uint32_t memoryType = findMemoryType(~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    uniformRings.resize(framesInFlight);
+    for (auto& ring : uniformRings)
+        ring.init(device, allocator, memoryType, size, alignment);
+    objectUniformOffsets.resize(objectCount);
+}
 
-    VkDescriptorPoolCreateInfo poolInfo {};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+// One instance stream per frame in flight. The instanced path writes it from
+// the transform jobs through a persistent mapping; the GPU-driven path keeps
+// it in device memory and writes it from the culling pass.
+void createInstanceBuffers()
+{
+    if (drawPath == DrawPath::PerDraw || drawPath == DrawPath::PushConstants)
+        return;
+    bool gpuWritten = drawPath == DrawPath::GpuDriven;
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (gpuWritten ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0);
+    VkMemoryPropertyFlags properties = gpuWritten ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                                  : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    instanceBuffers.resize(framesInFlight);
+    instanceBuffersMemory.resize(framesInFlight);
+    for (size_t i = 0; i < framesInFlight; i++)
+        createBuffer(sizeof(InstanceData) * objectCount, usage, properties, instanceBuffers[i], instanceBuffersMemory[i]);
+}
 
-    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create descriptor pool!");
+// The static object records are uploaded once; draw records and the draw
+// count are rewritten by the culling pass every frame.
+void createCullBuffers()
+{
+    if (drawPath != DrawPath::GpuDriven)
+        return;
+    std::vector<GpuObject> objects(sceneObjects.size());
+    for (size_t i = 0; i < sceneObjects.size(); i++) {
+        const auto& object = sceneObjects[i];
+        objects[i].positionScale = glm::vec4(object.position, object.scale);
+        objects[i].colorSpin = glm::vec4(object.color, object.spin);
     }
+    VkDeviceSize objectsSize = sizeof(GpuObject) * objects.size();
+    createBuffer(objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, objectBuffer, objectBufferMemory);
+    uploads.enqueue(objectBuffer, 0, objects.data(), objectsSize);
+
+    drawCommandBuffers.resize(framesInFlight);
+    drawCommandBuffersMemory.resize(framesInFlight);
+    for (size_t i = 0; i < framesInFlight; i++) {
+        createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawCommandBuffers[i], drawCommandBuffersMemory[i]);
+    }
+}
+
+void createSceneBuffers()
+{
+    createUniformBuffers();
+    createInstanceBuffers();
+    createCullBuffers();
+}
+
+void destroySceneBuffers()
+{
+    for (auto& ring : uniformRings)
+        ring.destroy();
+    uniformRings.clear();
+    for (size_t i = 0; i < instanceBuffers.size(); i++)
+        destroyBuffer(instanceBuffers[i], instanceBuffersMemory[i]);
+    instanceBuffers.clear();
+    instanceBuffersMemory.clear();
+    if (objectBuffer != VK_NULL_HANDLE)
+        destroyBuffer(objectBuffer, objectBufferMemory);
+    objectBuffer = VK_NULL_HANDLE;
+    for (size_t i = 0; i < drawCommandBuffers.size(); i++)
+        destroyBuffer(drawCommandBuffers[i], drawCommandBuffersMemory[i]);
+    drawCommandBuffers.clear();
+    drawCommandBuffersMemory.clear();
+}
+
+// Pools are sized for the per-frame uniform and culling sets; should more be
+// needed, the allocator chains further pools instead of failing.
+void createDescriptorAllocator()
+{
+    descriptorAllocator.init(device, { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f }, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f } }, 2 * framesInFlight);
+}
+
+// The bindless heap behind --materials: procedural textures, two samplers and
+// a buffer of material records, all reached by index.
+void createDescriptorHeap()
+{
+    if (materialCount == 0)
+        return;
+    descriptorHeap.init(physicalDevice, device, deletionQueue, DescriptorHeap::Capacity {});
 }
 
+void writeDescriptorSets();
+
 void createDescriptorSets()
 {
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocInfo {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    allocInfo.pSetLayouts = layouts.data();
+    descriptorSets.resize(framesInFlight);
+    for (auto& set : descriptorSets)
+        set = descriptorAllocator.allocate(descriptorSetLayout);
+    writeDescriptorSets();
+}
 
-    descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate descriptor sets!");
-    }
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+void createCullDescriptorSets()
+{
+    if (cullDescriptorSetLayout == VK_NULL_HANDLE)
+        return;
+    cullDescriptorSets.resize(framesInFlight);
+    for (auto& set : cullDescriptorSets)
+        set = descriptorAllocator.allocate(cullDescriptorSetLayout);
+    writeDescriptorSets();
+}
+
+void writeDescriptorSets()
+{
+    for (size_t i = 0; i < framesInFlight; i++) {
         VkDescriptorBufferInfo bufferInfo {};
-        bufferInfo.buffer = uniformBuffers[i];
+        bufferInfo.buffer = uniformRings[i].buffer();
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof(UniformBufferObject);
 
@@ -1007,63 +1859,303 @@ void createDescriptorSets()
         descriptorWrite.dstSet = descriptorSets[i];
         descriptorWrite.dstBinding = 0;
         descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         descriptorWrite.descriptorCount = 1;
         descriptorWrite.pBufferInfo = &bufferInfo;
         descriptorWrite.pImageInfo = nullptr;
         descriptorWrite.pTexelBufferView = nullptr;
         vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
     }
+
+    if (drawPath != DrawPath::GpuDriven || cullDescriptorSets.empty())
+        return;
+    for (size_t i = 0; i < framesInFlight; i++) {
+        std::array<VkDescriptorBufferInfo, 3> bufferInfos {};
+        bufferInfos[0] = { objectBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[1] = { instanceBuffers[i], 0, VK_WHOLE_SIZE };
+        bufferInfos[2] = { drawCommandBuffers[i], 0, VK_WHOLE_SIZE };
+
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites {};
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++) {
+            descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[binding].dstSet = cullDescriptorSets[i];
+            descriptorWrites[binding].dstBinding = binding;
+            descriptorWrites[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[binding].descriptorCount = 1;
+            descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+        }
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void createParticleSystem()
+{
+    if (particleCount == 0)
+        return;
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    ParticleSystemInfo info {};
+    info.physicalDevice = physicalDevice;
+    info.device = device;
+    info.allocator = &allocator;
+    info.deviceLocalMemoryType = findMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    info.computeFamily = deviceQueueFamilies.computeFamily.value();
+    info.computeQueue = computeQueue;
+    info.graphicsFamily = deviceQueueFamilies.graphicsFamily.value();
+    info.graphicsTimeline = graphicsTimeline.semaphore();
+    info.particleCount = particleCount;
+    info.renderPass = renderPass;
+    info.colorFormat = swapchainImageFormat;
+    info.depthFormat = depthFormat;
+    info.cameraSetLayout = descriptorSetLayout;
+    info.pipelineCache = pipelineCache.handle();
+    info.timestampPeriod = benchFrames > 0 ? props.limits.timestampPeriod : 0.0f;
+    particles.init(info);
+    std::cout << "particles: " << particleCount << " on " << (particles.asyncCompute() ? "a dedicated compute queue" : "the graphics queue") << '\n';
+    particles.simulate(0, 0.0f);
+}
+
+// Fills the material textures with checkerboards, each its own hue and cell
+// size, and copies them in with one graphics queue submission.
+void uploadMaterialTextures()
+{
+    const VkDeviceSize textureBytes = MATERIAL_TEXTURE_SIZE * MATERIAL_TEXTURE_SIZE * 4;
+    VkBuffer stagingBuffer;
+    Allocation stagingMemory;
+    createBuffer(textureBytes * materialImages.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+    auto* texels = static_cast<uint8_t*>(stagingMemory.mapped);
+    for (size_t t = 0; t < materialImages.size(); t++) {
+        float hue = static_cast<float>(t) / static_cast<float>(materialImages.size());
+        auto channel = [hue](float offset) { return std::clamp(std::fabs(std::fmod(hue + offset, 1.0f) * 6.0f - 3.0f) - 1.0f, 0.0f, 1.0f); };
+        glm::vec3 color(channel(0.0f), channel(2.0f / 3.0f), channel(1.0f / 3.0f));
+        uint32_t cell = 4u << (t % 3);
+        for (uint32_t y = 0; y < MATERIAL_TEXTURE_SIZE; y++) {
+            for (uint32_t x = 0; x < MATERIAL_TEXTURE_SIZE; x++) {
+                float shade = ((x / cell + y / cell) % 2) ? 1.0f : 0.35f;
+                uint8_t* texel = texels + t * textureBytes + (y * MATERIAL_TEXTURE_SIZE + x) * 4;
+                texel[0] = static_cast<uint8_t>(color.x * shade * 255.0f);
+                texel[1] = static_cast<uint8_t>(color.y * shade * 255.0f);
+                texel[2] = static_cast<uint8_t>(color.z * shade * 255.0f);
+                texel[3] = 255;
+            }
+        }
+    }
+
+    VkCommandBufferAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer cbuffer;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &cbuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate texture upload command buffer!");
+    }
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cbuffer, &beginInfo);
+
+    std::vector<VkImageMemoryBarrier> barriers(materialImages.size());
+    for (size_t t = 0; t < materialImages.size(); t++) {
+        barriers[t].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[t].srcAccessMask = 0;
+        barriers[t].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[t].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[t].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[t].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[t].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[t].image = materialImages[t];
+        barriers[t].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    }
+    vkCmdPipelineBarrier(cbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+    for (size_t t = 0; t < materialImages.size(); t++) {
+        VkBufferImageCopy region {};
+        region.bufferOffset = t * textureBytes;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { MATERIAL_TEXTURE_SIZE, MATERIAL_TEXTURE_SIZE, 1 };
+        vkCmdCopyBufferToImage(cbuffer, stagingBuffer, materialImages[t], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    }
+    for (auto& barrier : barriers) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    vkCmdPipelineBarrier(cbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(barriers.size()), barriers.data());
+    if (vkEndCommandBuffer(cbuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record texture upload!");
+    }
+
+    // Signals the graphics timeline like a frame would, so frame numbers
+    // carry on from its value.
+    SubmitSemaphores semaphores;
+    frameNumber = graphicsTimeline.advance();
+    semaphores.signal(graphicsTimeline.semaphore(), frameNumber);
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cbuffer;
+    VkTimelineSemaphoreSubmitInfo timelineInfo {};
+    semaphores.apply(submitInfo, timelineInfo);
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit texture upload!");
+    }
+    graphicsTimeline.wait(frameNumber);
+    vkFreeCommandBuffers(device, commandPool, 1, &cbuffer);
+    destroyBuffer(stagingBuffer, stagingMemory);
+}
+
+void createMaterials()
+{
+    if (materialCount == 0)
+        return;
+    uint32_t textureCount = std::min(materialCount, MAX_MATERIAL_TEXTURES);
+    materialImages.resize(textureCount);
+    materialImagesMemory.resize(textureCount);
+    materialImageViews.resize(textureCount);
+    std::vector<DescriptorIndex> textureIndices(textureCount);
+    for (uint32_t t = 0; t < textureCount; t++) {
+        createImage(MATERIAL_TEXTURE_SIZE, MATERIAL_TEXTURE_SIZE, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            materialImages[t], materialImagesMemory[t]);
+        VkImageViewCreateInfo viewInfo {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = materialImages[t];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        if (vkCreateImageView(device, &viewInfo, nullptr, &materialImageViews[t]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create material image view!");
+        }
+    }
+    uploadMaterialTextures();
+    for (uint32_t t = 0; t < textureCount; t++)
+        textureIndices[t] = descriptorHeap.addSampledImage(materialImageViews[t]);
+
+    std::array<DescriptorIndex, 2> samplerIndices {};
+    for (uint32_t i = 0; i < materialSamplers.size(); i++) {
+        VkSamplerCreateInfo samplerInfo {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = i == 0 ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+        samplerInfo.minFilter = samplerInfo.magFilter;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &materialSamplers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create material sampler!");
+        }
+        samplerIndices[i] = descriptorHeap.addSampler(materialSamplers[i]);
+    }
+
+    std::vector<MaterialData> materials(materialCount);
+    for (uint32_t m = 0; m < materialCount; m++) {
+        // Materials sharing a texture still differ in tint and filtering.
+        float tint = 1.0f - 0.5f * static_cast<float>(m / textureCount % 2);
+        materials[m].tint = glm::vec4(tint, tint, tint, 1.0f);
+        materials[m].texture = textureIndices[m % textureCount];
+        materials[m].sampler = samplerIndices[m / textureCount % samplerIndices.size()];
+    }
+    VkDeviceSize size = sizeof(MaterialData) * materials.size();
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        materialBuffer, materialBufferMemory);
+    uploads.enqueue(materialBuffer, 0, materials.data(), size);
+    uploads.flush();
+    materialBufferIndex = descriptorHeap.addStorageBuffer(materialBuffer);
+    std::cout << "materials: " << materialCount << " over " << textureCount << " textures, heap of "
+              << descriptorHeap.capacity(DescriptorHeap::Kind::StorageBuffer) << " buffers, "
+              << descriptorHeap.capacity(DescriptorHeap::Kind::SampledImage) << " images, "
+              << descriptorHeap.capacity(DescriptorHeap::Kind::Sampler) << " samplers\n";
+}
+
+void destroyMaterials()
+{
+    if (materialCount == 0)
+        return;
+    destroyBuffer(materialBuffer, materialBufferMemory);
+    for (auto sampler : materialSamplers)
+        vkDestroySampler(device, sampler, nullptr);
+    for (size_t t = 0; t < materialImages.size(); t++) {
+        vkDestroyImageView(device, materialImageViews[t], nullptr);
+        vkDestroyImage(device, materialImages[t], nullptr);
+        allocator.free(materialImagesMemory[t]);
+    }
+    vkDestroyPipeline(device, materialPipeline, nullptr);
+    if (prepassMaterialPipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, prepassMaterialPipeline, nullptr);
+    vkDestroyPipelineLayout(device, materialPipelineLayout, nullptr);
+    descriptorHeap.destroy();
 }
 
 void initVulkan()
 {
     createInstance();
     setupDebugMessenger();
-    createSurface();
+    if (!headless)
+        createSurface();
     pickPhysicalDevice();
     createLogicalDevice();
-    createSwapChain();
+    allocator.init(physicalDevice, device);
+    pipelineCache.init(physicalDevice, device, pipelineCachePath);
+    if (headless)
+        createOffscreenTargets();
+    else
+        createSwapChain();
     createImageViews();
     createRenderPass();
     createDescriptorSetLayout();
+    createCullDescriptorSetLayout();
+    createDescriptorHeap();
+    auto pipelineStart = std::chrono::steady_clock::now();
     createGraphicsPipeline();
-    createFramebuffers();
+    createCullPipeline();
+    auto pipelineTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineStart).count();
+    std::cout << "pipeline creation: " << pipelineTime << " ms (" << (pipelineCache.warm() ? "warm" : "cold") << " cache)\n";
+    renderGraph.init(physicalDevice, device, allocator, deletionQueue);
+    if (cmdBeginRendering)
+        renderGraph.useDynamicRendering(cmdBeginRendering, cmdEndRendering);
+    std::cout << "rendering: " << (cmdBeginRendering ? "dynamic rendering" : "render passes and framebuffers") << '\n';
+    if (!headless) {
+        std::cout << "presentation: " << presentModeName(swapchainPresentMode) << ", " << swapchainImages.size() << " images, "
+                  << framesInFlight << " frames in flight";
+        if (maxQueuedFrames > 0)
+            std::cout << ", at most " << maxQueuedFrames << " queued (" << (waitForPresent ? "present wait" : "graphics timeline") << ')';
+        std::cout << '\n';
+    }
     createCommandPool();
+    createUploadManager();
+    auto meshStart = std::chrono::steady_clock::now();
+    loadMesh();
     createVertexBuffer();
     createIndexBuffer();
-    createUniformBuffers();
-    createDescriptorPool();
+    if (meshFile.isOpen()) {
+        auto meshTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - meshStart).count();
+        const MeshHeader& header = meshFile.header();
+        std::cout << "mesh: " << header.vertexCount << " vertices, " << header.indexCount / 3 << " triangles, "
+                  << header.submeshCount << " submeshes, " << meshFile.fileSize() / (1024.0 * 1024.0) << " MiB staged in "
+                  << meshTime << " ms\n";
+        meshFile.close();
+    }
+    uploads.flush();
+    createScene();
+    createSceneBuffers();
+    createDescriptorAllocator();
     createDescriptorSets();
+    createCullDescriptorSets();
     createCommandBuffer();
+    createRecordCommandPools();
     createSyncObjects();
+    createMaterials();
+    createTimestampQueryPool();
+    createParticleSystem();
 }
 
-void recordCommandBuffer(VkCommandBuffer cbuffer, uint32_t imageIndex)
+void setViewportAndScissor(VkCommandBuffer cbuffer)
 {
-    VkCommandBufferBeginInfo beginInfo {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0;
-    beginInfo.pInheritanceInfo = nullptr;
-
-    if (vkBeginCommandBuffer(cbuffer, &beginInfo) != VK_SUCCESS) {
-        throw std::runtime_error("failed to begin recording command buffer!");
-    }
-
-    VkRenderPassBeginInfo renderPassInfo {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = swapchainFrameBuffers[imageIndex];
-    renderPassInfo.renderArea.offset = { 0, 0 };
-    renderPassInfo.renderArea.extent = swapchainExtent;
-
-    VkClearValue clearColor = { { { 0.0f, 0.0f, 0.0f, 1.0f } } };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-
-    vkCmdBeginRenderPass(cbuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
     VkViewport viewport {};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -1077,17 +2169,298 @@ void recordCommandBuffer(VkCommandBuffer cbuffer, uint32_t imageIndex)
     scissor.offset = { 0, 0 };
     scissor.extent = swapchainExtent;
     vkCmdSetScissor(cbuffer, 0, 1, &scissor);
+}
+
+// Draws visibleObjects[firstVisible, visibleEnd), or only their depth with
+// the prepass pipelines.
+void recordDraws(VkCommandBuffer cbuffer, uint32_t firstVisible, uint32_t visibleEnd, bool depthOnly)
+{
+    // With materials the heap is bound once; draws only push an index.
+    // The prepass never reads a material.
+    VkPipelineLayout layout = pipelineLayout;
+    MaterialPush push { materialBufferIndex, 0 };
+    bool materials = materialPipeline != VK_NULL_HANDLE && !depthOnly;
+    if (materialPipeline != VK_NULL_HANDLE) {
+        layout = materialPipelineLayout;
+        vkCmdBindPipeline(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly ? prepassMaterialPipeline : materialPipeline);
+        if (materials)
+            descriptorHeap.bind(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1);
+    } else {
+        vkCmdBindPipeline(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly ? prepassPipeline : graphicsPipeline);
+    }
+    setViewportAndScissor(cbuffer);
 
     VkBuffer vertexBuffers[] = { vertexBuffer };
     VkDeviceSize offsets[] = { 0 };
     vkCmdBindVertexBuffers(cbuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(cbuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-    vkCmdBindDescriptorSets(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+    vkCmdBindIndexBuffer(cbuffer, indexBuffer, 0, meshIndexType);
 
     // vkCmdDraw(cbuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-    vkCmdDrawIndexed(cbuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+    for (uint32_t v = firstVisible; v < visibleEnd; v++) {
+        uint32_t i = visibleObjects[v];
+        uint32_t offset = objectUniformOffsets[i];
+        vkCmdBindDescriptorSets(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &descriptorSets[currentFrame], 1, &offset);
+        if (materials) {
+            push.material = i % materialCount;
+            vkCmdPushConstants(cbuffer, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialPush), &push);
+        }
+        vkCmdDrawIndexed(cbuffer, meshIndexCount, 1, 0, 0, 0);
+    }
+}
+
+// Emits draw items [first, end) of the sorted render queue, binding a
+// pipeline or mesh only where the key says it changes.
+void recordQueuedDraws(VkCommandBuffer cbuffer, size_t first, size_t end, bool depthOnly)
+{
+    const auto& pipelines = depthOnly ? prepassQueuePipelines : queuePipelines;
+    uint32_t boundPipeline = UINT32_MAX;
+    uint32_t boundMesh = UINT32_MAX;
+    const DrawItem* items = renderQueue.data();
+    for (size_t i = first; i < end; i++) {
+        uint64_t key = items[i].key;
+        if (drawKeyPipeline(key) != boundPipeline) {
+            boundPipeline = drawKeyPipeline(key);
+            vkCmdBindPipeline(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[boundPipeline]);
+            setViewportAndScissor(cbuffer);
+        }
+        if (drawKeyMesh(key) != boundMesh) {
+            boundMesh = drawKeyMesh(key);
+            VkBuffer vertexBuffers[] = { vertexBuffer };
+            VkDeviceSize offsets[] = { 0 };
+            vkCmdBindVertexBuffers(cbuffer, 0, 1, vertexBuffers, offsets);
+            vkCmdBindIndexBuffer(cbuffer, indexBuffer, 0, meshIndexType);
+        }
+        vkCmdPushConstants(cbuffer, pushPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &objectMvps[items[i].payload]);
+        vkCmdDrawIndexed(cbuffer, meshIndexCount, 1, 0, 0, 0);
+    }
+}
+
+// Draws `count` instances of the mesh, reading their transforms and colors
+// from `instances` starting at `offset`, in a single call.
+void drawInstances(VkCommandBuffer cbuffer, VkBuffer instances, VkDeviceSize offset, uint32_t count)
+{
+    VkBuffer vertexBuffers[] = { vertexBuffer, instances };
+    VkDeviceSize offsets[] = { 0, offset };
+    vkCmdBindVertexBuffers(cbuffer, 0, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(cbuffer, indexBuffer, 0, meshIndexType);
+    vkCmdBindDescriptorSets(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 1, &cameraUniformOffset);
+    vkCmdDrawIndexed(cbuffer, meshIndexCount, count, 0, 0, 0);
+}
+
+void recordInstancedDraws(VkCommandBuffer cbuffer, bool depthOnly)
+{
+    vkCmdBindPipeline(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly ? prepassInstancedPipeline : instancedPipeline);
+    setViewportAndScissor(cbuffer);
+    if (instanceCount > 0)
+        drawInstances(cbuffer, instanceBuffers[currentFrame], 0, instanceCount);
+}
+
+// Runs the culling pass over every object. The render graph orders it after
+// the draw record reset and before the indirect draw and the vertex fetch.
+void recordCullPass(VkCommandBuffer cbuffer)
+{
+    vkCmdBindPipeline(cbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(cbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[currentFrame], 0, nullptr);
+    vkCmdPushConstants(cbuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), &cullParams);
+    vkCmdDispatch(cbuffer, (cullParams.objectCount + 63) / 64, 1, 1);
+}
+
+void recordIndirectDraws(VkCommandBuffer cbuffer, bool depthOnly)
+{
+    vkCmdBindPipeline(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnly ? prepassInstancedPipeline : instancedPipeline);
+    setViewportAndScissor(cbuffer);
+    VkBuffer vertexBuffers[] = { vertexBuffer, instanceBuffers[currentFrame] };
+    VkDeviceSize offsets[] = { 0, 0 };
+    vkCmdBindVertexBuffers(cbuffer, 0, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(cbuffer, indexBuffer, 0, meshIndexType);
+    vkCmdBindDescriptorSets(cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 1, &cameraUniformOffset);
+
+    // A single record, as the scene has a single mesh; the culling pass set
+    // how many instances it draws.
+    vkCmdDrawIndexedIndirect(cbuffer, drawCommandBuffers[currentFrame], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void recordParticles(VkCommandBuffer cbuffer)
+{
+    setViewportAndScissor(cbuffer);
+    particles.draw(cbuffer, simulationStep, descriptorSets[currentFrame], cameraUniformOffset);
+}
+
+// Runs as job `job` of recordJobCount: resets that job's pool for the current
+// frame and records its contiguous slice of the objects into a secondary
+// command buffer that continues the primary's render pass.
+void recordSecondary(uint32_t job, const RenderPassContext& pass)
+{
+    vkResetCommandPool(device, recordCommandPools[currentFrame][job], 0);
+    VkCommandBuffer cbuffer = recordCommandBuffers[currentFrame][job];
+
+    VkCommandBufferInheritanceInfo inheritanceInfo {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = pass.renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = pass.framebuffer;
+    // Without a render pass the secondary learns the attachment formats here.
+    VkCommandBufferInheritanceRenderingInfo renderingInfo {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    renderingInfo.colorAttachmentCount = pass.colorAttachmentCount;
+    renderingInfo.pColorAttachmentFormats = pass.colorFormats;
+    renderingInfo.depthAttachmentFormat = pass.depthFormat;
+    renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    if (pass.renderPass == VK_NULL_HANDLE)
+        inheritanceInfo.pNext = &renderingInfo;
+
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    if (vkBeginCommandBuffer(cbuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording secondary command buffer!");
+    }
+
+    bool queued = drawPath == DrawPath::PushConstants;
+    uint64_t count = queued ? renderQueue.size() : visibleObjectCount;
+    auto first = static_cast<uint32_t>(count * job / recordJobCount);
+    auto end = static_cast<uint32_t>(count * (job + 1) / recordJobCount);
+    if (queued)
+        recordQueuedDraws(cbuffer, first, end, false);
+    else
+        recordDraws(cbuffer, first, end, false);
+    if (job == 0 && particles.enabled())
+        recordParticles(cbuffer);
 
-    vkCmdEndRenderPass(cbuffer);
+    if (vkEndCommandBuffer(cbuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record secondary command buffer!");
+    }
+}
+
+// Every CPU-side draw path, in one primary command buffer.
+void recordSceneDraws(VkCommandBuffer cbuffer, bool depthOnly)
+{
+    if (drawPath == DrawPath::Instanced)
+        recordInstancedDraws(cbuffer, depthOnly);
+    else if (drawPath == DrawPath::PushConstants)
+        recordQueuedDraws(cbuffer, 0, renderQueue.size(), depthOnly);
+    else
+        recordDraws(cbuffer, 0, visibleObjectCount, depthOnly);
+}
+
+// Declares this frame's passes and what they touch; the graph works out the
+// barriers between them and the layout transitions of the swapchain image.
+void buildFrameGraph(uint32_t imageIndex)
+{
+    renderGraph.reset();
+    // The submission waits for the acquire semaphore at the color output
+    // stage, so the first transition of the image has to wait there too.
+    ResourceUsage acquired { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+    // PRESENT_SRC_KHR is only valid with VK_KHR_swapchain enabled; offscreen
+    // targets are left ready for a readback copy instead.
+    ResourceUsage finalUsage = headless ? USAGE_TRANSFER_READ : USAGE_PRESENT;
+    RenderResource backbuffer = renderGraph.importImage("backbuffer", swapchainImages[imageIndex], swapchainImageViews[imageIndex],
+        swapchainImageFormat, swapchainExtent, acquired, finalUsage);
+    // Transient, so it follows the swapchain extent: a resize recreates it.
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (depthFormat != VK_FORMAT_D32_SFLOAT)
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    RenderResource depth = renderGraph.createImage("depth", { depthFormat, swapchainExtent, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspect });
+    // After a prepass the scene pass keeps its depth and only tests against it.
+    VkAttachmentLoadOp sceneDepthLoad = depthPrepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+    if (drawPath == DrawPath::GpuDriven) {
+        RenderResource drawCommands = renderGraph.importBuffer("draw-commands", drawCommandBuffers[currentFrame]);
+        RenderResource instances = renderGraph.importBuffer("instances", instanceBuffers[currentFrame]);
+        RenderResource objects = renderGraph.importBuffer("objects", objectBuffer);
+        renderGraph.addPass("reset-draws", [](const RenderPassContext& pass) {
+            VkDrawIndexedIndirectCommand command { meshIndexCount, 0, 0, 0, 0 };
+            vkCmdUpdateBuffer(pass.commandBuffer, drawCommandBuffers[currentFrame], 0, sizeof(command), &command);
+        }).write(drawCommands, USAGE_TRANSFER_WRITE);
+        renderGraph.addPass("cull", [](const RenderPassContext& pass) { recordCullPass(pass.commandBuffer); })
+            .read(objects, USAGE_COMPUTE_READ)
+            .write(drawCommands, USAGE_COMPUTE_READ_WRITE)
+            .write(instances, USAGE_COMPUTE_WRITE);
+        if (depthPrepass) {
+            renderGraph.addPass("depth-prepass", [](const RenderPassContext& pass) { recordIndirectDraws(pass.commandBuffer, true); })
+                .depthAttachment(depth, VK_ATTACHMENT_LOAD_OP_CLEAR, CLEAR_DEPTH)
+                .read(drawCommands, USAGE_INDIRECT_READ)
+                .read(instances, USAGE_VERTEX_READ);
+        }
+        renderGraph.addPass("scene", [](const RenderPassContext& pass) {
+            recordIndirectDraws(pass.commandBuffer, false);
+            if (particles.enabled())
+                recordParticles(pass.commandBuffer);
+        })
+            .colorAttachment(backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, CLEAR_COLOR)
+            .depthAttachment(depth, sceneDepthLoad, CLEAR_DEPTH)
+            .read(drawCommands, USAGE_INDIRECT_READ)
+            .read(instances, USAGE_VERTEX_READ);
+        return;
+    }
+
+    // The prepass is cheap enough to record inline even when the scene pass
+    // is split across jobs.
+    if (depthPrepass) {
+        renderGraph.addPass("depth-prepass", [](const RenderPassContext& pass) { recordSceneDraws(pass.commandBuffer, true); })
+            .depthAttachment(depth, VK_ATTACHMENT_LOAD_OP_CLEAR, CLEAR_DEPTH);
+    }
+
+    // A handful of instanced draws gains nothing from being split across jobs.
+    if (recordJobCount > 0 && (drawPath == DrawPath::PerDraw || drawPath == DrawPath::PushConstants)) {
+        renderGraph.addPass("scene", [](const RenderPassContext& pass) {
+            jobs->parallelFor(recordJobCount, 1, [&pass](uint32_t first, uint32_t end) {
+                for (uint32_t job = first; job < end; job++)
+                    recordSecondary(job, pass);
+            });
+            auto& secondaries = recordCommandBuffers[currentFrame];
+            vkCmdExecuteCommands(pass.commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+        })
+            .colorAttachment(backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, CLEAR_COLOR)
+            .depthAttachment(depth, sceneDepthLoad, CLEAR_DEPTH)
+            .secondaryCommandBuffers();
+        return;
+    }
+
+    renderGraph.addPass("scene", [](const RenderPassContext& pass) {
+        recordSceneDraws(pass.commandBuffer, false);
+        if (particles.enabled())
+            recordParticles(pass.commandBuffer);
+    })
+        .colorAttachment(backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, CLEAR_COLOR)
+        .depthAttachment(depth, sceneDepthLoad, CLEAR_DEPTH);
+}
+
+void recordCommandBuffer(VkCommandBuffer cbuffer, uint32_t imageIndex)
+{
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = 0;
+    beginInfo.pInheritanceInfo = nullptr;
+
+    if (vkBeginCommandBuffer(cbuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    bool writeTimestamps = timestampQueryPool != VK_NULL_HANDLE && profiler.enabled();
+    if (writeTimestamps) {
+        vkCmdResetQueryPool(cbuffer, timestampQueryPool, currentFrame * 2, 2);
+        vkCmdWriteTimestamp(cbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2);
+    }
+
+    // The particle buffer changes queue families around the graph; that
+    // handover pairs with the compute queue's release and stays explicit.
+    if (particles.enabled())
+        particles.acquireForGraphics(cbuffer, simulationStep);
+    buildFrameGraph(imageIndex);
+    renderGraph.compile();
+    if (dumpGraph) {
+        renderGraph.printSummary(std::cout);
+        dumpGraph = false;
+    }
+    renderGraph.execute(cbuffer);
+    if (particles.enabled())
+        particles.releaseFromGraphics(cbuffer, simulationStep);
+    if (writeTimestamps) {
+        vkCmdWriteTimestamp(cbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2 + 1);
+        timestampsWritten[currentFrame] = true;
+    }
     if (vkEndCommandBuffer(cbuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
@@ -1095,16 +2468,23 @@ void recordCommandBuffer(VkCommandBuffer cbuffer, uint32_t imageIndex)
 
 void cleanupSwapchain()
 {
-    for (auto framebuffer : swapchainFrameBuffers) {
-        vkDestroyFramebuffer(device, framebuffer, nullptr);
-    }
     for (auto imageView : swapchainImageViews) {
         vkDestroyImageView(device, imageView, nullptr);
     }
 
+    if (headless) {
+        for (size_t i = 0; i < swapchainImages.size(); i++) {
+            vkDestroyImage(device, swapchainImages[i], nullptr);
+            allocator.free(offscreenImagesMemory[i]);
+        }
+        return;
+    }
     vkDestroySwapchainKHR(device, swapChain, nullptr);
 }
 
+// Nothing waits for the GPU here: the new swapchain is created from the old
+// one, and the old one, its views and the framebuffers built on them go to
+// the deletion queue until the frames that used them have completed.
 void recreateSwapchain()
 {
     int width = 0, height = 0;
@@ -1113,14 +2493,85 @@ void recreateSwapchain()
         glfwGetFramebufferSize(window, &width, &height);
         glfwWaitEvents();
     }
-    vkDeviceWaitIdle(device);
-
-    cleanupSwapchain();
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
 
+    VkSwapchainKHR oldSwapchain = swapChain;
+    std::vector<VkImageView> oldImageViews = std::move(swapchainImageViews);
+    swapchainImageViews.clear();
+    renderGraph.releaseFramebuffers();
     createSwapChain();
     createImageViews();
-    createFramebuffers();
+    presentId = 0;
+    deletionQueue.push([oldSwapchain, oldImageViews] {
+        for (auto imageView : oldImageViews)
+            vkDestroyImageView(device, imageView, nullptr);
+        vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
+    });
+}
+
+struct CameraSample {
+    glm::mat4 view;
+    glm::mat4 proj;
+};
+
+// The camera orbits the origin; dragging with the left mouse button turns it.
+// This is the input whose latency --late-latch shortens.
+CameraSample sampleCamera()
+{
+    static float yaw = 0.0f;
+    static double lastCursorX = 0.0;
+    static bool dragging = false;
+    if (!headless) {
+        glfwPollEvents();
+        double cursorX, cursorY;
+        glfwGetCursorPos(window, &cursorX, &cursorY);
+        bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        if (pressed && dragging)
+            yaw += static_cast<float>(cursorX - lastCursorX) * 0.01f;
+        dragging = pressed;
+        lastCursorX = cursorX;
+    }
+    cameraSampleTime = std::chrono::steady_clock::now();
+    float c = std::cos(yaw), s = std::sin(yaw);
+    glm::vec3 eye(2.0f * (c - s), 2.0f * (s + c), 2.0f);
+    CameraSample camera;
+    camera.view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    // Near and far swapped for reverse-Z: depth 1 at the near plane falling
+    // to 0 at the far one, which spreads float precision evenly over distance.
+    camera.proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float)swapchainExtent.height, 10.0f, 0.1f);
+    camera.proj[1][1] *= -1;
+    return camera;
+}
+
+// How many candidates the culling jobs split between them: every object,
+// or with --bvh those the hierarchy found in the frustum.
+uint32_t gatherCullCandidates(const Frustum& frustum)
+{
+    if (!useBvh)
+        return static_cast<uint32_t>(sceneObjects.size());
+    ScopedPhaseTimer timer(profiler, FramePhase::BvhQuery);
+    bvhCandidates.clear();
+    objectBvh.queryFrustum(frustum, bvhCandidates);
+    return static_cast<uint32_t>(bvhCandidates.size());
+}
+
+// Calls visit(index) for each object in view among candidates [first, end).
+// Without --bvh the candidates are the objects themselves, culled a batch at
+// a time with the SIMD kernel and visited in index order; with it they were
+// already culled by the hierarchy.
+template <typename Visit>
+void forEachVisible(const Frustum& frustum, uint32_t first, uint32_t end, Visit&& visit)
+{
+    if (useBvh) {
+        for (uint32_t k = first; k < end; k++)
+            visit(bvhCandidates[k]);
+        return;
+    }
+    std::array<uint32_t, CULL_BATCH> visible;
+    for (uint32_t batch = first; batch < end; batch += CULL_BATCH) {
+        uint32_t survivors = cullSpheres(frustum, objectSpheres, batch, std::min(batch + CULL_BATCH, end), visible.data(), cullSimdLevel);
+        for (uint32_t k = 0; k < survivors; k++)
+            visit(visible[k]);
+    }
 }
 
 void updateUniformBuffer(uint32_t currentImage)
@@ -1128,107 +2579,513 @@ void updateUniformBuffer(uint32_t currentImage)
     static auto startTime = std::chrono::high_resolution_clock::now();
     auto currentTime = std::chrono::high_resolution_clock::now();
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-    UniformBufferObject ubo {};
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 10.0f);
-    ubo.proj[1][1] *= -1;
+    CameraSample camera = sampleCamera();
+    const glm::mat4& view = camera.view;
+    const glm::mat4& proj = camera.proj;
+    cameraViewProj = proj * view;
+    Frustum frustum = extractFrustum(cameraViewProj);
+
+    auto& ring = uniformRings[currentImage];
+    ring.reset();
+    auto count = static_cast<uint32_t>(sceneObjects.size());
+    latchedCameraBlock = nullptr;
+    latchedObjectBlocks = nullptr;
+
+    if (drawPath == DrawPath::Instanced || drawPath == DrawPath::GpuDriven || particles.enabled()) {
+        void* data;
+        cameraUniformOffset = ring.allocate(sizeof(UniformBufferObject), &data);
+        // The push constant MVPs cannot be latched, so particles drawn with
+        // them keep this camera too rather than run ahead of the objects.
+        if (drawPath != DrawPath::PushConstants)
+            latchedCameraBlock = static_cast<UniformBufferObject*>(data);
+        UniformBufferObject ubo {};
+        ubo.model = glm::mat4(1.0f);
+        ubo.view = view;
+        ubo.proj = proj;
+        std::memcpy(data, &ubo, sizeof(ubo));
+    }
+
+    // Nothing per object happens on the CPU: the culling pass gets the
+    // frustum and the clock and does the rest.
+    if (drawPath == DrawPath::GpuDriven) {
+        cullParams.planes = frustum.planes;
+        cullParams.time = time;
+        cullParams.objectCount = count;
+        cullParams.boundingRadius = meshBoundingRadius;
+        return;
+    }
+
+    if (drawPath == DrawPath::Instanced) {
+
+        auto* instances = static_cast<InstanceData*>(instanceBuffersMemory[currentImage].mapped);
+        uint32_t candidates = gatherCullCandidates(frustum);
+        std::atomic<uint32_t> visibleCount { 0 };
+        jobs->parallelFor(candidates, jobs->grainSize(candidates), [&](uint32_t first, uint32_t end) {
+            // Survivors are gathered locally and appended in batches, so the
+            // shared counter is touched once per batch rather than per object.
+            std::array<InstanceData, 64> batch;
+            uint32_t batchSize = 0;
+            auto flushBatch = [&] {
+                uint32_t at = visibleCount.fetch_add(batchSize, std::memory_order_relaxed);
+                std::memcpy(instances + at, batch.data(), batchSize * sizeof(InstanceData));
+                batchSize = 0;
+            };
+            forEachVisible(frustum, first, end, [&](uint32_t i) {
+                const auto& object = sceneObjects[i];
+                batch[batchSize++] = { objectTransform(object, time), glm::vec4(object.color, 1.0f) };
+                if (batchSize == batch.size())
+                    flushBatch();
+            });
+            if (batchSize > 0)
+                flushBatch();
+        });
+        instanceCount = visibleCount.load();
+        return;
+    }
+
+    // Each visible object becomes a draw item keyed by view depth, front to
+    // back, with its MVP multiplied here once rather than per vertex. The
+    // MVPs are recorded as push constants, so --late-latch cannot reach them.
+    if (drawPath == DrawPath::PushConstants) {
+        DrawItem* items = renderQueue.begin(count);
+        uint32_t candidates = gatherCullCandidates(frustum);
+        std::atomic<uint32_t> visibleCount { 0 };
+        jobs->parallelFor(candidates, jobs->grainSize(candidates), [&](uint32_t first, uint32_t end) {
+            std::array<DrawItem, 64> batch;
+            uint32_t batchSize = 0;
+            auto flushBatch = [&] {
+                uint32_t at = visibleCount.fetch_add(batchSize, std::memory_order_relaxed);
+                std::memcpy(items + at, batch.data(), batchSize * sizeof(DrawItem));
+                batchSize = 0;
+            };
+            forEachVisible(frustum, first, end, [&](uint32_t i) {
+                const auto& object = sceneObjects[i];
+                objectMvps[i] = cameraViewProj * objectTransform(object, time);
+                float depth = -(view * glm::vec4(object.position, 1.0f)).z;
+                batch[batchSize++] = { makeDrawKey(0, 0, 0, depth), i };
+                if (batchSize == batch.size())
+                    flushBatch();
+            });
+            if (batchSize > 0)
+                flushBatch();
+        });
+        renderQueue.end(visibleCount.load());
+        ScopedPhaseTimer timer(profiler, FramePhase::QueueSort);
+        renderQueue.sort();
+        return;
+    }
 
-    memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+    // One contiguous run of blocks, so every object's offset is known up
+    // front and the jobs can fill the mapped ring in any order.
+    VkDeviceSize stride = ring.alignedSize(sizeof(UniformBufferObject));
+    void* data;
+    uint32_t base = ring.allocate(stride * count, &data);
+    latchedObjectBlocks = static_cast<uint8_t*>(data);
+    latchedObjectStride = stride;
+
+    // The survivors go through the render queue too, keyed by view depth
+    // alone, so they are drawn front to back and the depth test rejects
+    // hidden fragments before they are shaded.
+    DrawItem* items = renderQueue.begin(count);
+    uint32_t candidates = gatherCullCandidates(frustum);
+    std::atomic<uint32_t> visibleCount { 0 };
+    jobs->parallelFor(candidates, jobs->grainSize(candidates), [&](uint32_t first, uint32_t end) {
+        UniformBufferObject ubo {};
+        ubo.view = view;
+        ubo.proj = proj;
+        std::array<DrawItem, 64> batch;
+        uint32_t batchSize = 0;
+        auto flushBatch = [&] {
+            uint32_t at = visibleCount.fetch_add(batchSize, std::memory_order_relaxed);
+            std::memcpy(items + at, batch.data(), batchSize * sizeof(DrawItem));
+            batchSize = 0;
+        };
+        forEachVisible(frustum, first, end, [&](uint32_t i) {
+            const auto& object = sceneObjects[i];
+            ubo.model = objectTransform(object, time);
+            std::memcpy(static_cast<char*>(data) + i * stride, &ubo, sizeof(ubo));
+            objectUniformOffsets[i] = static_cast<uint32_t>(base + i * stride);
+            float depth = -(view * glm::vec4(object.position, 1.0f)).z;
+            batch[batchSize++] = { makeDrawKey(0, 0, 0, depth), i };
+            if (batchSize == batch.size())
+                flushBatch();
+        });
+        if (batchSize > 0)
+            flushBatch();
+    });
+    visibleObjectCount = visibleCount.load();
+    renderQueue.end(visibleObjectCount);
+    ScopedPhaseTimer timer(profiler, FramePhase::QueueSort);
+    renderQueue.sort();
+    for (uint32_t v = 0; v < visibleObjectCount; v++)
+        visibleObjects[v] = renderQueue.data()[v].payload;
 }
 
-void drawFrame()
+// Late latching: the camera is sampled again after recording and written
+// over the blocks updateUniformBuffer filled, so the frame shows input from
+// just before submit. Culling keeps the earlier camera, so an object turning
+// into view in between can appear a frame late.
+void latchCamera()
 {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-    uint32_t imageIndex;
-    auto result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        framebufferResized = true;
-        recreateSwapchain();
+    CameraSample camera = sampleCamera();
+    if (latchedCameraBlock) {
+        std::memcpy(&latchedCameraBlock->view, &camera.view, sizeof(camera.view));
+        std::memcpy(&latchedCameraBlock->proj, &camera.proj, sizeof(camera.proj));
+    }
+    if (!latchedObjectBlocks)
         return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("failed to acquire swap chain image!");
+    jobs->parallelFor(visibleObjectCount, jobs->grainSize(visibleObjectCount), [&](uint32_t first, uint32_t end) {
+        for (uint32_t v = first; v < end; v++) {
+            auto* ubo = reinterpret_cast<UniformBufferObject*>(latchedObjectBlocks + visibleObjects[v] * latchedObjectStride);
+            std::memcpy(&ubo->view, &camera.view, sizeof(camera.view));
+            std::memcpy(&ubo->proj, &camera.proj, sizeof(camera.proj));
+        }
+    });
+}
+
+// Holds the next frame back before it samples any input, so the time spent
+// waiting adds no latency to what the frame shows.
+void paceFrame()
+{
+    if (targetFps > 0.0) {
+        auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+        auto now = std::chrono::steady_clock::now();
+        // A frame that fell behind starts the schedule over instead of
+        // letting the following ones catch up back to back.
+        if (nextFrameDeadline + period < now)
+            nextFrameDeadline = now;
+        else
+            std::this_thread::sleep_until(nextFrameDeadline);
+        nextFrameDeadline += period;
     }
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
-    vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    uint64_t nextFrame = frameNumber + 1;
+    if (maxQueuedFrames == 0 || nextFrame <= maxQueuedFrames)
+        return;
+    if (waitForPresent) {
+        // Present ids start over with every swapchain, so right after a
+        // recreation there is nothing to wait for yet.
+        if (presentId + 1 > maxQueuedFrames) {
+            // Bounded so a swapchain that stopped presenting (minimised,
+            // out of date) cannot stall the loop; a timeout just lets the
+            // frame start.
+            const uint64_t timeout = 100'000'000;
+            waitForPresent(device, swapChain, presentId + 1 - maxQueuedFrames, timeout);
+        }
+        return;
+    }
+    // Without present wait the best available signal is the frame having
+    // rendered.
+    graphicsTimeline.wait(nextFrame - maxQueuedFrames);
+}
 
-    updateUniformBuffer(currentFrame);
+void drawFrame()
+{
+    if (targetFps > 0.0 || maxQueuedFrames > 0) {
+        ScopedPhaseTimer timer(profiler, FramePhase::Pacing);
+        paceFrame();
+    }
+    {
+        ScopedPhaseTimer timer(profiler, FramePhase::FenceWait);
+        graphicsTimeline.wait(slotFrameNumbers[currentFrame]);
+    }
+    // The timeline may well be past the frame just waited for, which lets
+    // deferred destruction run earlier than the slot alone would allow.
+    deletionQueue.beginFrame(frameNumber + 1, graphicsTimeline.completed());
+    collectGpuTimestamps(currentFrame);
+    uint32_t imageIndex = currentFrame;
+    if (!headless) {
+        ScopedPhaseTimer timer(profiler, FramePhase::Acquire);
+        auto result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            framebufferResized = true;
+            recreateSwapchain();
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
+    }
+    // The next step goes to the compute queue now so that it integrates while
+    // this frame draws the current one.
+    if (particles.enabled()) {
+        particles.simulate(simulationStep + 1, PARTICLE_TIME_STEP);
+        double computeTime;
+        if (particles.takeComputeTime(computeTime))
+            profiler.record(FramePhase::GpuCompute, computeTime);
+    }
+    // Transforms, culling and the uniform writes run as jobs; recording needs
+    // their dynamic offsets and visibility, so it starts once they are done.
+    {
+        ScopedPhaseTimer timer(profiler, FramePhase::UniformUpdate);
+        updateUniformBuffer(currentFrame);
+    }
+    {
+        ScopedPhaseTimer timer(profiler, FramePhase::Record);
+        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    }
     VkSubmitInfo submitInfo {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
+    // Anything streamed since the last frame goes out as one transfer batch
+    // that this submission waits on.
+    // Waiting on the latest token covers every earlier batch as well.
+    uploads.flush();
+    uint64_t frameValue = graphicsTimeline.advance();
+    SubmitSemaphores semaphores;
+    if (!headless)
+        semaphores.wait(imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    if (uploads.submitted() > 0)
+        semaphores.wait(uploads.timeline(), UploadManager::CONSUMER_WAIT_STAGES, uploads.submitted());
+    if (particles.enabled()) {
+        semaphores.wait(particles.timeline(), ParticleSystem::GRAPHICS_WAIT_STAGE, ParticleSystem::readyValue(simulationStep));
+        particles.consumed(simulationStep, frameValue);
+    }
+    semaphores.signal(graphicsTimeline.semaphore(), frameValue);
+    if (!headless)
+        semaphores.signal(renderFinishedSemaphores[currentFrame]);
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    VkTimelineSemaphoreSubmitInfo timelineInfo {};
+    semaphores.apply(submitInfo, timelineInfo);
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
+    if (lateLatch)
+        latchCamera();
+    {
+        ScopedPhaseTimer timer(profiler, FramePhase::Submit);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+    }
+    if (profiler.enabled())
+        profiler.record(FramePhase::InputToSubmit, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cameraSampleTime).count());
+    frameNumber = frameValue;
+    slotFrameNumbers[currentFrame] = frameNumber;
+    simulationStep++;
+
+    if (headless) {
+        currentFrame = (currentFrame + 1) % framesInFlight;
+        return;
     }
 
     VkPresentInfoKHR presentInfo {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
     VkSwapchainKHR swapchains[] = { swapChain };
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapchains;
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
+    VkPresentIdKHR presentIdInfo {};
+    if (waitForPresent) {
+        ++presentId;
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
+        presentInfo.pNext = &presentIdInfo;
+    }
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    VkResult result;
+    {
+        ScopedPhaseTimer timer(profiler, FramePhase::Present);
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         recreateSwapchain();
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to present swap chain image!");
     }
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+bool shouldClose()
+{
+    if (quitRequested)
+        return true;
+    return !headless && glfwWindowShouldClose(window);
 }
 
 void mainLoop()
 {
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    uint64_t warmupFrames = benchFrames > 0 ? BENCH_WARMUP_FRAMES : 0;
+    for (uint64_t frame = 0; !shouldClose() && (frameLimit == 0 || frame < frameLimit); frame++) {
+        if (frame == warmupFrames && benchFrames > 0)
+            profiler.begin(benchFrames);
+        ScopedPhaseTimer timer(profiler, FramePhase::Frame);
+        if (!headless)
+            glfwPollEvents();
         drawFrame();
     }
 
     vkDeviceWaitIdle(device);
+    for (uint32_t i = 0; i < framesInFlight; i++)
+        collectGpuTimestamps(i);
+}
+
+// Rebuilds everything sized by the object count or the draw path.
+void resizeScene(uint32_t count)
+{
+    vkDeviceWaitIdle(device);
+    destroySceneBuffers();
+    objectCount = count;
+    createScene();
+    createSceneBuffers();
+    writeDescriptorSets();
+}
+
+// --bench-instancing: the same grid drawn with one draw per quad (through
+// uniform blocks and through the push constant queue), with a single CPU-fed
+// instanced draw and with a GPU-culled indirect instanced draw, from 1 to 1M
+// quads.
+void runInstancingBenchmark()
+{
+    std::cout << std::setw(10) << "quads" << std::setw(16) << "path" << std::setw(12) << "frame ms"
+              << std::setw(12) << "update ms" << std::setw(12) << "record ms" << std::setw(12) << "gpu ms" << '\n';
+    for (uint32_t count = 1; count <= INSTANCING_BENCH_MAX_OBJECTS; count *= 10) {
+        for (DrawPath path : { DrawPath::PerDraw, DrawPath::PushConstants, DrawPath::Instanced, DrawPath::GpuDriven }) {
+            if (path == DrawPath::PerDraw && count > INSTANCING_BENCH_PER_DRAW_LIMIT)
+                continue;
+            drawPath = path;
+            resizeScene(count);
+            for (uint64_t frame = 0; frame < BENCH_WARMUP_FRAMES + instancingBenchFrames && !shouldClose(); frame++) {
+                if (frame == BENCH_WARMUP_FRAMES)
+                    profiler.begin(instancingBenchFrames);
+                ScopedPhaseTimer timer(profiler, FramePhase::Frame);
+                if (!headless)
+                    glfwPollEvents();
+                drawFrame();
+            }
+            vkDeviceWaitIdle(device);
+            for (uint32_t i = 0; i < framesInFlight; i++)
+                collectGpuTimestamps(i);
+            if (shouldClose())
+                return;
+
+            std::cout << std::fixed << std::setprecision(3) << std::setw(10) << count
+                      << std::setw(16) << drawPathName(path)
+                      << std::setw(12) << profiler.summary(FramePhase::Frame).mean
+                      << std::setw(12) << profiler.summary(FramePhase::UniformUpdate).mean
+                      << std::setw(12) << profiler.summary(FramePhase::Record).mean
+                      << std::setw(12) << profiler.summary(FramePhase::GpuRenderPass).mean << '\n'
+                      << std::defaultfloat;
+        }
+    }
+}
+
+void reportBenchmark()
+{
+    if (!profiler.enabled())
+        return;
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    std::cout << "benchmark: " << profiler.sampleCount(FramePhase::Frame) << " frames on " << props.deviceName << '\n';
+    profiler.printReport(std::cout);
+    if (profiler.sampleCount(FramePhase::GpuCompute) > 0 && profiler.sampleCount(FramePhase::GpuRenderPass) > 0) {
+        // Were the two queues serialized, a GPU-bound frame could not be
+        // shorter than both passes back to back; compare the frame time of a
+        // --no-async-compute run against this one to see what overlap bought.
+        double serial = profiler.summary(FramePhase::GpuRenderPass).mean + profiler.summary(FramePhase::GpuCompute).mean;
+        double frame = profiler.summary(FramePhase::Frame).mean;
+        std::cout << "gpu work back to back: " << serial << " ms, frame: " << frame << " ms ("
+                  << (particles.asyncCompute() ? "async compute" : "compute on the graphics queue") << ")\n";
+    }
+
+    std::vector<std::pair<std::string, std::string>> metadata = {
+        { "device", props.deviceName },
+        { "mode", headless ? "headless" : "windowed" },
+        { "extent", std::to_string(swapchainExtent.width) + "x" + std::to_string(swapchainExtent.height) },
+        { "objects", std::to_string(sceneObjects.size()) },
+        { "job_threads", std::to_string(jobs->threadCount()) },
+        { "record_jobs", std::to_string(recordJobCount) },
+        { "path", drawPathName(drawPath) },
+        { "mesh", meshPath.empty() ? "quad" : meshPath },
+        { "vertex_bytes", std::to_string(packedVertices ? PackedVertexLayout::stride : FloatVertexLayout::stride) },
+        { "particles", std::to_string(particleCount) },
+        { "async_compute", particles.enabled() && particles.asyncCompute() ? "true" : "false" },
+        { "dynamic_rendering", cmdBeginRendering ? "true" : "false" },
+        { "present_mode", headless ? "none" : presentModeName(swapchainPresentMode) },
+        { "swapchain_images", std::to_string(swapchainImages.size()) },
+        { "frames_in_flight", std::to_string(framesInFlight) },
+        { "target_fps", std::to_string(targetFps) },
+        { "max_queued_frames", std::to_string(maxQueuedFrames) },
+        { "present_wait", waitForPresent ? "true" : "false" },
+        { "late_latch", lateLatch ? "true" : "false" },
+        { "depth_prepass", depthPrepass ? "true" : "false" },
+        { "bvh", useBvh ? "true" : "false" },
+        { "materials", std::to_string(materialCount) },
+        { "descriptor_pools", std::to_string(descriptorAllocator.poolCount()) },
+    };
+    if (benchJsonPath.empty()) {
+        profiler.writeJson(std::cout, metadata);
+        return;
+    }
+    std::ofstream file(benchJsonPath);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open benchmark report file!");
+    }
+    profiler.writeJson(file, metadata);
+    std::cout << "benchmark report written to " << benchJsonPath << '\n';
 }
 
 void cleanup()
 {
+    jobs.reset();
+    deletionQueue.flush();
     cleanupSwapchain();
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-    }
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    destroySceneBuffers();
+    descriptorAllocator.destroy();
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-    vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    destroyMaterials();
+    if (cullPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, cullPipeline, nullptr);
+        vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
+    }
+    destroyBuffer(indexBuffer, indexBufferMemory);
+    destroyBuffer(vertexBuffer, vertexBufferMemory);
+    uploads.destroy();
+    particles.destroy();
+    renderGraph.destroy();
+    pipelineCache.save();
+    pipelineCache.destroy();
     vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    if (instancedPipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(device, instancedPipeline, nullptr);
+    if (pushPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, pushPipeline, nullptr);
+        vkDestroyPipelineLayout(device, pushPipelineLayout, nullptr);
+    }
+    for (auto pipeline : { prepassPipeline, prepassInstancedPipeline, prepassPushPipeline }) {
+        if (pipeline != VK_NULL_HANDLE)
+            vkDestroyPipeline(device, pipeline, nullptr);
+    }
     vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
     vkDestroyRenderPass(device, renderPass, nullptr);
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    if (prepassRenderPass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(device, prepassRenderPass, nullptr);
+    for (size_t i = 0; i < framesInFlight; i++) {
         vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
+    }
+    graphicsTimeline.destroy();
+    if (timestampQueryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+    for (const auto& pools : recordCommandPools) {
+        for (auto pool : pools)
+            vkDestroyCommandPool(device, pool, nullptr);
     }
     vkDestroyCommandPool(device, commandPool, nullptr);
+    allocator.destroy();
     vkDestroyDevice(device, nullptr);
     if (enableValidationLayers) {
         destroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
     }
+    if (headless) {
+        vkDestroyInstance(instance, nullptr);
+        return;
+    }
     vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
 
@@ -1236,16 +3093,222 @@ void cleanup()
     glfwTerminate();
 }
 
+void printUsage(const char* program)
+{
+    std::cerr << "usage: " << program << " [options]\n"
+              << "  --headless      render offscreen without a window or surface\n"
+              << "  --frames <n>    exit after rendering n frames\n"
+              << "  --bench <n>     time n frames (after a warmup) and report percentiles\n"
+              << "  --bench-json <path>\n"
+              << "                  write the benchmark JSON report to path instead of stdout\n"
+              << "  --objects <n>   draw n quads, each with its own uniform block (default 1)\n"
+              << "  --instanced     draw all objects with a single instanced draw call\n"
+              << "  --gpu-driven    cull on the GPU into one indirect instanced draw\n"
+              << "  --push-constants\n"
+              << "                  draw from a depth-sorted render queue, pushing each object's MVP\n"
+              << "  --mesh <path>   draw a mesh-converter file instead of the quad\n"
+              << "  --packed-vertices\n"
+              << "                  store positions as half floats and colors as 8-bit unorm\n"
+              << "  --particles <n> simulate n particles on the compute queue and draw them\n"
+              << "  --no-async-compute\n"
+              << "                  run the particle simulation on the graphics queue\n"
+              << "  --no-dynamic-rendering\n"
+              << "                  record with render passes and framebuffers even if dynamic rendering is available\n"
+              << "  --present-mode <fifo|fifo-relaxed|mailbox|immediate>\n"
+              << "                  present mode, falling back to fifo (default: mailbox if available)\n"
+              << "  --swapchain-images <n>\n"
+              << "                  swapchain images to ask for, within what the surface allows\n"
+              << "  --frames-in-flight <n>\n"
+              << "                  frames the CPU may record ahead of the GPU (default 2)\n"
+              << "  --target-fps <n>\n"
+              << "                  start frames at most n times a second\n"
+              << "  --max-queued-frames <n>\n"
+              << "                  start a frame only once the one n frames back was presented\n"
+              << "                  (VK_KHR_present_wait) or, without it, rendered\n"
+              << "  --late-latch    sample the camera again right before submit\n"
+              << "  --depth-prepass draw depth alone first, then shade only the nearest surface\n"
+              << "  --bvh           cull on the CPU paths with a bounding volume hierarchy query\n"
+              << "                  instead of testing every object\n"
+              << "  --materials <n> draw the per-draw path with n textured materials from a bindless\n"
+              << "                  descriptor heap (needs descriptor indexing)\n"
+              << "  --dump-graph    print the first frame's render graph: passes, barriers and\n"
+              << "                  transient memory\n"
+              << "  --record-jobs <n>\n"
+              << "                  record draws as n jobs into secondary command buffers\n"
+              << "  --job-threads <n>\n"
+              << "                  worker threads besides the main thread (default: one per extra core)\n"
+              << "  --pipeline-cache <path>\n"
+              << "                  where the pipeline cache is loaded from and saved to\n"
+              << "                  (default pipeline_cache.bin)\n"
+              << "  --bench-alloc <n>\n"
+              << "                  run n allocate/free operations against the memory allocator and exit\n"
+              << "  --bench-sync <n>\n"
+              << "                  time n empty submissions per test, with fences and with a timeline semaphore, and exit\n"
+              << "  --bench-cull <n>\n"
+              << "                  time the CPU culling kernels over n bounding spheres and exit\n"
+              << "  --bench-bvh <n> time BVH builds, refits and queries over n moving boxes against\n"
+              << "                  linear culling and exit\n"
+              << "  --bench-transforms <n>\n"
+              << "                  time world matrix updates of an n-node hierarchy into a mapped buffer and exit\n"
+              << "  --bench-instancing <n>\n"
+              << "                  time n frames per draw path for 1 to 1M quads and exit\n"
+              << "  --bench-jobs <n>\n"
+              << "                  time the per-frame job work for n objects on 1..N threads and exit\n";
+}
+
+bool parseArguments(int argc, char** argv)
+{
+    // Numbers that do not parse or do not fit are usage errors too.
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--headless") {
+                headless = true;
+            } else if (arg == "--frames" && i + 1 < argc) {
+                frameLimit = std::stoull(argv[++i]);
+            } else if (arg == "--bench" && i + 1 < argc) {
+                benchFrames = std::stoull(argv[++i]);
+            } else if (arg == "--bench-json" && i + 1 < argc) {
+                benchJsonPath = argv[++i];
+            } else if (arg == "--objects" && i + 1 < argc) {
+                objectCount = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(argv[++i])));
+            } else if (arg == "--instanced") {
+                drawPath = DrawPath::Instanced;
+            } else if (arg == "--gpu-driven") {
+                drawPath = DrawPath::GpuDriven;
+            } else if (arg == "--push-constants") {
+                drawPath = DrawPath::PushConstants;
+            } else if (arg == "--mesh" && i + 1 < argc) {
+                meshPath = argv[++i];
+            } else if (arg == "--packed-vertices") {
+                packedVertices = true;
+            } else if (arg == "--particles" && i + 1 < argc) {
+                particleCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--no-async-compute") {
+                asyncComputeAllowed = false;
+            } else if (arg == "--no-dynamic-rendering") {
+                dynamicRenderingAllowed = false;
+            } else if (arg == "--present-mode" && i + 1 < argc) {
+                std::string name = argv[++i];
+                auto mode = std::find_if(PRESENT_MODE_NAMES.begin(), PRESENT_MODE_NAMES.end(), [&](const auto& entry) { return name == entry.first; });
+                if (mode == PRESENT_MODE_NAMES.end()) {
+                    printUsage(argv[0]);
+                    return false;
+                }
+                requestedPresentMode = mode->second;
+            } else if (arg == "--swapchain-images" && i + 1 < argc) {
+                requestedSwapchainImages = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+                framesInFlight = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(argv[++i])));
+            } else if (arg == "--target-fps" && i + 1 < argc) {
+                targetFps = std::stod(argv[++i]);
+            } else if (arg == "--max-queued-frames" && i + 1 < argc) {
+                maxQueuedFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--late-latch") {
+                lateLatch = true;
+            } else if (arg == "--depth-prepass") {
+                depthPrepass = true;
+            } else if (arg == "--bvh") {
+                useBvh = true;
+            } else if (arg == "--materials" && i + 1 < argc) {
+                materialCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--dump-graph") {
+                dumpGraph = true;
+            } else if (arg == "--record-jobs" && i + 1 < argc) {
+                recordJobCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--job-threads" && i + 1 < argc) {
+                jobThreadCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--pipeline-cache" && i + 1 < argc) {
+                pipelineCachePath = argv[++i];
+            } else if (arg == "--bench-alloc" && i + 1 < argc) {
+                allocBenchIterations = std::stoull(argv[++i]);
+            } else if (arg == "--bench-sync" && i + 1 < argc) {
+                syncBenchIterations = std::stoull(argv[++i]);
+            } else if (arg == "--bench-cull" && i + 1 < argc) {
+                cullBenchObjects = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--bench-bvh" && i + 1 < argc) {
+                bvhBenchObjects = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--bench-transforms" && i + 1 < argc) {
+                transformBenchNodes = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--bench-instancing" && i + 1 < argc) {
+                instancingBenchFrames = std::stoull(argv[++i]);
+            } else if (arg == "--bench-jobs" && i + 1 < argc) {
+                jobBenchObjects = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+    } catch (const std::invalid_argument&) {
+        printUsage(argv[0]);
+        return false;
+    } catch (const std::out_of_range&) {
+        printUsage(argv[0]);
+        return false;
+    }
+    if (benchFrames > 0)
+        frameLimit = BENCH_WARMUP_FRAMES + benchFrames;
+    if (materialCount > 0 && drawPath != DrawPath::PerDraw) {
+        std::cerr << "warning: --materials only applies to the per-draw path, ignoring it\n";
+        materialCount = 0;
+    }
+    if (useBvh && drawPath == DrawPath::GpuDriven) {
+        std::cerr << "warning: --bvh does not apply to the GPU-driven path, ignoring it\n";
+        useBvh = false;
+    }
+    return true;
+}
+
 void run()
 {
-    initWindow();
+    if (jobBenchObjects > 0) {
+        runJobSystemBenchmark(jobBenchObjects, std::cout);
+        return;
+    }
+    if (cullBenchObjects > 0) {
+        runCullBenchmark(cullBenchObjects, std::cout);
+        return;
+    }
+    if (bvhBenchObjects > 0) {
+        runBvhBenchmark(bvhBenchObjects, std::cout);
+        return;
+    }
+    uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::make_unique<JobSystem>(jobThreadCount.value_or(hardwareThreads - 1));
+    if (headless) {
+        std::signal(SIGINT, signalHandler);
+        std::signal(SIGTERM, signalHandler);
+    } else {
+        initWindow();
+    }
     initVulkan();
-    mainLoop();
+    if (instancingBenchFrames > 0) {
+        runInstancingBenchmark();
+    } else if (allocBenchIterations > 0) {
+        uint32_t memoryType = findMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        runAllocatorBenchmark(allocator, device, memoryType, allocBenchIterations, std::cout);
+    } else if (syncBenchIterations > 0) {
+        runSyncBenchmark(device, graphicsQueue, syncBenchIterations, std::cout);
+    } else if (transformBenchNodes > 0) {
+        // Host-visible like the instance streams, so the update writes
+        // straight into memory the GPU reads.
+        VkBuffer transformBuffer;
+        Allocation transformBufferMemory;
+        createBuffer(sizeof(glm::mat4) * transformBenchNodes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, transformBuffer, transformBufferMemory);
+        runTransformBenchmark(transformBenchNodes, static_cast<glm::mat4*>(transformBufferMemory.mapped), *jobs, std::cout);
+        destroyBuffer(transformBuffer, transformBufferMemory);
+    } else {
+        mainLoop();
+        reportBenchmark();
+    }
     cleanup();
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    if (!parseArguments(argc, argv))
+        return 1;
     run();
     return 0;
 }
@@ -1,2 +1,9 @@
 glslc shader.vert -o vert.spv
 glslc shader.frag -o frag.spv
+glslc instanced.vert -o instanced_vert.spv
+glslc cull.comp -o cull_comp.spv
+glslc particles.comp -o particles_comp.spv
+glslc particle.vert -o particle_vert.spv
+glslc material.vert -o material_vert.spv
+glslc material.frag -o material_frag.spv
+glslc push.vert -o push_vert.spv
@@ -0,0 +1,20 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+// Per instance; the matrix takes locations 2 to 5.
+layout(location = 2) in mat4 instanceModel;
+layout(location = 6) in vec4 instanceColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+	gl_Position = ubo.proj * ubo.view * instanceModel * vec4(inPosition, 1.0);
+	fragColor = inColor * instanceColor.rgb;
+}
@@ -0,0 +1,30 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// The descriptor heap (DescriptorHeap.hpp), bound as set 1.
+struct Material {
+	vec4 tint;
+	uint textureIndex;
+	uint samplerIndex;
+};
+
+layout(set = 1, binding = 0) readonly buffer Materials {
+	Material materials[];
+} heapBuffers[];
+layout(set = 1, binding = 1) uniform texture2D heapTextures[];
+layout(set = 1, binding = 2) uniform sampler heapSamplers[];
+
+layout(push_constant) uniform MaterialPush {
+	uint materialBuffer;
+	uint material;
+} push;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	Material m = heapBuffers[push.materialBuffer].materials[push.material];
+	vec4 texel = texture(sampler2D(heapTextures[nonuniformEXT(m.textureIndex)], heapSamplers[nonuniformEXT(m.samplerIndex)]), fragUV);
+	outColor = vec4(texel.rgb * m.tint.rgb * mix(vec3(1.0), fragColor, 0.25), 1.0);
+}
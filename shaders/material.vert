@@ -0,0 +1,20 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV;
+
+void main() {
+	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+	fragColor = inColor;
+	// Planar mapping; the quad spans -0.5..0.5.
+	fragUV = inPosition.xy + 0.5;
+}
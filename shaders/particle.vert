@@ -0,0 +1,19 @@
+#version 450
+
+// The frame's camera block; model is unused, particles are in world space.
+layout(binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+// xyz position, w speed.
+layout(location = 0) in vec4 inPositionSpeed;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+	gl_Position = ubo.proj * ubo.view * vec4(inPositionSpeed.xyz, 1.0);
+	gl_PointSize = 1.0;
+	fragColor = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.6, 0.2), clamp(inPositionSpeed.w - 0.5, 0.0, 1.0));
+}
@@ -0,0 +1,17 @@
+#version 450
+
+// The whole per-draw state: the model-view-projection matrix, multiplied
+// once per draw on the CPU instead of once per vertex here.
+layout(push_constant) uniform PerDraw {
+	mat4 mvp;
+} draw;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+	gl_Position = draw.mvp * vec4(inPosition, 1.0);
+	fragColor = inColor;
+}
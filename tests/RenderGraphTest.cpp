@@ -0,0 +1,187 @@
+// Checks what the render graph compiles: culled passes, the barriers and
+// layout transitions between the rest, and how transients share memory.
+// Only buffers and imported images are involved and attachments go through
+// dynamic rendering, so neither a device nor init() is needed.
+
+#include <iostream>
+#include <vector>
+
+#include "RenderGraph.hpp"
+
+namespace {
+auto noop = [](const RenderPassContext&) { };
+
+// Never called: nothing is executed, compile() only needs them set.
+VKAPI_ATTR void VKAPI_CALL noBeginRendering(VkCommandBuffer, const VkRenderingInfo*) { }
+VKAPI_ATTR void VKAPI_CALL noEndRendering(VkCommandBuffer) { }
+
+const ResourceUsage UNUSED { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED };
+
+int failures = 0;
+
+void expect(bool condition, const char* what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << '\n';
+        failures++;
+    }
+}
+
+RenderGraph graph;
+
+RenderResource importTarget(std::optional<ResourceUsage> final)
+{
+    return graph.importImage("target", VK_NULL_HANDLE, VK_NULL_HANDLE, VK_FORMAT_R8G8B8A8_UNORM, { 64, 64 }, UNUSED, final);
+}
+
+TransientLifetime lifetime(VkDeviceSize size, uint32_t firstPass, uint32_t lastPass, uint32_t memoryTypeBits = 1)
+{
+    TransientLifetime transient;
+    transient.requirements = { size, 256, memoryTypeBits };
+    transient.firstPass = firstPass;
+    transient.lastPass = lastPass;
+    return transient;
+}
+
+void testBufferHazards()
+{
+    graph.reset();
+    RenderResource buffer = graph.importBuffer("buffer", VK_NULL_HANDLE);
+    graph.addPass("write", noop).write(buffer, USAGE_COMPUTE_READ_WRITE).sideEffect();
+    graph.addPass("read", noop).read(buffer, USAGE_COMPUTE_READ).sideEffect();
+    graph.compile();
+    const auto& sameStage = graph.passBarriers(1);
+    expect(sameStage.srcStages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT && sameStage.dstStages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+            && sameStage.memory.srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT && sameStage.memory.dstAccessMask == VK_ACCESS_SHADER_READ_BIT,
+        "a read waits for a write through the same stage");
+
+    graph.reset();
+    buffer = graph.importBuffer("buffer", VK_NULL_HANDLE);
+    graph.addPass("write", noop).write(buffer, USAGE_COMPUTE_WRITE).sideEffect();
+    graph.addPass("first-read", noop).read(buffer, USAGE_INDIRECT_READ).sideEffect();
+    graph.addPass("second-read", noop).read(buffer, USAGE_INDIRECT_READ).sideEffect();
+    graph.compile();
+    const auto& otherStage = graph.passBarriers(1);
+    expect(otherStage.srcStages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT && otherStage.dstStages == VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+            && otherStage.memory.srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT
+            && otherStage.memory.dstAccessMask == VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        "a read waits for a write through another stage");
+    expect(graph.passBarriers(2).empty(), "a read after a read through the same stage needs nothing");
+
+    graph.reset();
+    buffer = graph.importBuffer("buffer", VK_NULL_HANDLE);
+    graph.addPass("first-write", noop).write(buffer, USAGE_COMPUTE_READ_WRITE).sideEffect();
+    graph.addPass("second-write", noop).write(buffer, USAGE_COMPUTE_READ_WRITE).sideEffect();
+    graph.compile();
+    const auto& afterWrite = graph.passBarriers(1);
+    expect(afterWrite.srcStages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT && afterWrite.memory.srcAccessMask == VK_ACCESS_SHADER_WRITE_BIT,
+        "a write waits for the write before it");
+
+    graph.reset();
+    buffer = graph.importBuffer("buffer", VK_NULL_HANDLE);
+    graph.addPass("read", noop).read(buffer, USAGE_COMPUTE_READ).sideEffect();
+    graph.addPass("write", noop).write(buffer, USAGE_TRANSFER_WRITE).sideEffect();
+    graph.compile();
+    const auto& afterRead = graph.passBarriers(1);
+    expect(afterRead.srcStages == VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT && afterRead.dstStages == VK_PIPELINE_STAGE_TRANSFER_BIT
+            && afterRead.memory.srcAccessMask == 0,
+        "a write after a read waits for it without flushing anything");
+}
+
+void testLayoutTransitions()
+{
+    graph.reset();
+    RenderResource image = importTarget(std::nullopt);
+    graph.addPass("upload", noop).write(image, USAGE_TRANSFER_WRITE).sideEffect();
+    graph.addPass("sample", noop).read(image, USAGE_FRAGMENT_SAMPLED).sideEffect();
+    graph.compile();
+    const auto& upload = graph.passBarriers(0);
+    expect(upload.images.size() == 1 && upload.images[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED
+            && upload.images[0].newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        "the first use moves an image out of its initial layout");
+    const auto& sample = graph.passBarriers(1);
+    expect(sample.images.size() == 1 && sample.images[0].oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+            && sample.images[0].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+            && sample.images[0].srcAccessMask == VK_ACCESS_TRANSFER_WRITE_BIT && sample.images[0].dstAccessMask == VK_ACCESS_SHADER_READ_BIT
+            && sample.srcStages == VK_PIPELINE_STAGE_TRANSFER_BIT && sample.dstStages == VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        "a layout change carries the write it has to wait for");
+
+    graph.reset();
+    image = importTarget(USAGE_PRESENT);
+    graph.addPass("sample", noop).read(image, USAGE_FRAGMENT_SAMPLED).sideEffect();
+    graph.addPass("draw", noop).colorAttachment(image, VK_ATTACHMENT_LOAD_OP_CLEAR);
+    graph.compile();
+    const auto& draw = graph.passBarriers(1);
+    expect(draw.images.size() == 1 && draw.images[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED
+            && draw.images[0].newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        "a cleared attachment discards the layout it was in");
+    const auto& output = graph.finalTransitions();
+    expect(output.images.size() == 1 && output.images[0].oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+            && output.images[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+            && output.images[0].srcAccessMask == VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        "a frame output ends in its final layout");
+}
+
+void testCulling()
+{
+    graph.reset();
+    RenderResource buffer = graph.importBuffer("buffer", VK_NULL_HANDLE);
+    RenderResource image = importTarget(USAGE_PRESENT);
+    graph.addPass("unread", noop).write(buffer, USAGE_COMPUTE_WRITE);
+    graph.addPass("producer", noop).write(buffer, USAGE_COMPUTE_WRITE);
+    graph.addPass("consumer", noop).read(buffer, USAGE_VERTEX_READ).colorAttachment(image, VK_ATTACHMENT_LOAD_OP_CLEAR);
+    graph.addPass("dangling", noop).write(buffer, USAGE_COMPUTE_WRITE);
+    graph.compile();
+    expect(graph.passLive(1) && graph.passLive(2), "passes leading to a frame output are kept");
+    expect(graph.passLive(0), "a partial write keeps the writer before it");
+    expect(!graph.passLive(3), "a pass whose writes nobody reads is culled");
+
+    graph.reset();
+    image = importTarget(USAGE_PRESENT);
+    graph.addPass("overdrawn", noop).colorAttachment(image, VK_ATTACHMENT_LOAD_OP_CLEAR);
+    graph.addPass("drawn", noop).colorAttachment(image, VK_ATTACHMENT_LOAD_OP_CLEAR);
+    graph.addPass("blended", noop).colorAttachment(image, VK_ATTACHMENT_LOAD_OP_LOAD);
+    graph.compile();
+    expect(!graph.passLive(0), "a pass whose attachment is cleared again is culled");
+    expect(graph.passLive(1) && graph.passLive(2), "a loaded attachment keeps the pass that drew it");
+
+    graph.reset();
+    buffer = graph.importBuffer("buffer", VK_NULL_HANDLE);
+    graph.addPass("unread", noop).write(buffer, USAGE_COMPUTE_WRITE).sideEffect();
+    graph.compile();
+    expect(graph.passLive(0), "a pass with side effects is never culled");
+}
+
+void testAliasing()
+{
+    std::vector<VkMemoryRequirements> slots;
+    auto slotOf = RenderGraph::packTransients({ lifetime(1024, 0, 1), lifetime(4096, 2, 3) }, slots);
+    expect(slots.size() == 1 && slotOf[0] == slotOf[1] && slots[0].size == 4096, "transients alive at different times share memory");
+
+    slotOf = RenderGraph::packTransients({ lifetime(1024, 0, 2), lifetime(1024, 1, 3) }, slots);
+    expect(slots.size() == 2 && slotOf[0] != slotOf[1], "overlapping transients get memory of their own");
+
+    slotOf = RenderGraph::packTransients({ lifetime(1024, 0, 1), lifetime(1024, 1, 2) }, slots);
+    expect(slots.size() == 2, "a transient is not aliased by one born in its last pass");
+
+    slotOf = RenderGraph::packTransients({ lifetime(1024, 0, 0, 1), lifetime(1024, 1, 1, 2) }, slots);
+    expect(slots.size() == 2, "transients of incompatible memory types do not share memory");
+
+    slotOf = RenderGraph::packTransients({ lifetime(1024, 0, 0), lifetime(4096, 0, 3), lifetime(2048, 1, 3) }, slots);
+    expect(slots.size() == 2 && slotOf[1] == 0 && slotOf[2] == 1 && slotOf[0] == 1 && slots[1].size == 2048,
+        "the largest transients are placed first");
+}
+}
+
+int main()
+{
+    graph.useDynamicRendering(noBeginRendering, noEndRendering);
+    testBufferHazards();
+    testLayoutTransitions();
+    testCulling();
+    testAliasing();
+
+    if (failures == 0)
+        std::cout << "render graph: all passed\n";
+    return failures == 0 ? 0 : 1;
+}